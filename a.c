@@ -1,16 +1,41 @@
 // statusbar-hsdwm (hardcoded config; cleaned up + color-fix)
 // if the command stays alive we read lines as they come
 // if it exits we respawn after HARD_INTERVAL seconds
+// everything runs from one epoll loop; nothing wakes up unless a fd or deadline fires
+// "@module" commands (clock, load, mem, ...) are computed in-process, no fork
+// right cmds run in the background on their own intervals; draws use cached output
 
 #define _GNU_SOURCE
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
 #include <X11/Xutil.h>
+#include <X11/Xproto.h>
 #include <X11/Xft/Xft.h>
+#ifdef XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif
+#ifdef XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#ifdef XRANDR
+#include <xcb/randr.h>
+#endif
+#endif
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
 #include <sys/inotify.h>
-#include <sys/poll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
 #include <sys/wait.h>
+#include <dirent.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,16 +44,22 @@
 #include <ctype.h>
 #include <math.h>
 #include <errno.h>
-#include <stdarg.h>
 #include <time.h>
+#include <spawn.h>
+#include <pthread.h>
+#include "hsdbar_shm.h"
 
 #if !defined(MAX)
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 #endif
+#if !defined(MIN)
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#endif
 
 /* -------------------------
-   hardcoded configuration
-   edit these values directly
+   built-in defaults
+   edit these values directly, or override them at runtime in
+   $XDG_CONFIG_HOME/hsdbar/config (see config_parse)
    -------------------------*/
 
 #define HARD_FONT      "xterm-12"
@@ -36,16 +67,32 @@
 #define HARD_FG        "#000000"
 #define HARD_FOCUS_BG  "#1e90ff"
 #define HARD_WS_COUNT  9
-#define HARD_CMD       "date '+%a %b %d %H:%M:%S'"
+#define HARD_CMD       "@clock:%a %b %d %H:%M:%S"
 #define HARD_FULLSCREEN 1
 #define HARD_BAR_HEIGHT 28
 #define HARD_INTERVAL   1 /* seconds */
+#define HARD_MAX_FPS    30 /* redraw cap for bursty producers; clicks bypass it */
+#define HARD_BACKOFF_MAX 60 /* seconds, cap for the restart delay of a crashing HARD_CMD */
+#define HARD_STABLE_UPTIME 30 /* seconds a HARD_CMD run must last to reset the backoff */
+#define HARD_MARQUEE    0  /* px/s a status too wide for the bar scrolls at; 0 = cut it with an ellipsis */
 
-#define RIGHT_CMD_COUNT 2
-static const char *RIGHT_CMDS[RIGHT_CMD_COUNT] = {
-    "uptime",
-    "whoami"
+/* HARD_CMD and RIGHT_CMDS entries starting with '@' are built-in modules
+   that run in-process and never fork:
+     @clock[:strftime fmt]  @uptime  @load  @mem
+     @battery[:BAT0]        @net[:iface]  (no iface = all but lo) */
+
+/* right side commands, each with its own refresh interval in seconds
+   (0 = run once at startup, or the module's own rate for '@' entries).
+   output is cached, redraws never fork */
+typedef struct { const char *cmd; int interval; } RightCmdDef;
+static const RightCmdDef RIGHT_CMDS[] = {
+    { "@load",    0 },
+    { "@mem",     0 },
+    { "@battery", 0 },
+    { "@uptime",  0 },
+    { "whoami",   0 },
 };
+#define RIGHT_CMD_COUNT ((int)(sizeof(RIGHT_CMDS) / sizeof(RIGHT_CMDS[0])))
 
 #define MAX_TEXT 512
 #define PADDING 8
@@ -53,554 +100,1819 @@ static const char *RIGHT_CMDS[RIGHT_CMD_COUNT] = {
 #define TAG_SPACING 12
 #define MAX_WS 20
 #define MAX_RIGHT_CMDS 32
+#define MAX_DAMAGE 8
+#define TEXT_CACHE_SIZE 64
+#define MAX_WATCHES 64
+#define LINE_RING_SIZE 8192 /* power of two */
+#define MAX_TIMERS (MAX_RIGHT_CMDS + 8)
+#define SPAWN_MAX_ARGS 32
+#define MAX_BG_PROCS 16
+#define MAX_IPC_CLIENTS 8
+#define MAX_IPC_SEGS 16
+#define MAX_BARS 8
+#define HIST_SUB 8                          /* histogram buckets per power of two */
+#define HIST_BUCKETS (24 * HIST_SUB)        /* covers 1 us .. ~1 min */
+#define MAX_RUNS 32            /* styled runs per text segment */
+#define COLOR_CACHE_SIZE 64    /* markup colors, power of two */
+#define MAX_MARKUP_FONTS 4
+#define CLICK_BUTTONS 5        /* ^ca() buttons: left, middle, right, wheel up, wheel down */
+#define MAX_REGIONS (MAX_WS + 2 * MAX_RUNS)
+#define MAX_CA_DEPTH 8         /* nested ^ca() */
+#define SWITCH_CONFIRM_MS 500 /* how long an optimistic tag highlight waits for the wm */
+#define MARQUEE_GAP (4 * PADDING) /* between the end of a scrolling status and its next copy */
+#define XREQ_BATCH 64          /* requests in flight per batch (XCB backend) */
+#ifdef XCB
+#define X_BACKEND "xcb"
+#else
+#define X_BACKEND "xlib"
+#endif
 
 typedef struct { int x, w; int tag; } TagRect;
 
+/* every atom the bar uses, interned in one batch at startup */
+enum {
+    NetCurrentDesktop, NetNumberOfDesktops, NetClientList, NetWMDesktop,
+    NetWMWindowType, NetWMWindowTypeDock, NetWMState, NetWMStateAbove,
+    NetWMStateSticky, NetWMPid, NetWMStrut, NetWMStrutPartial, AtomLast
+};
+static char *g_atom_names[AtomLast] = {
+    "_NET_CURRENT_DESKTOP", "_NET_NUMBER_OF_DESKTOPS", "_NET_CLIENT_LIST", "_NET_WM_DESKTOP",
+    "_NET_WM_WINDOW_TYPE", "_NET_WM_WINDOW_TYPE_DOCK", "_NET_WM_STATE", "_NET_WM_STATE_ABOVE",
+    "_NET_WM_STATE_STICKY", "_NET_WM_PID", "_NET_WM_STRUT", "_NET_WM_STRUT_PARTIAL",
+};
+
+/* one 32-bit property read; vals is valid until props_free */
+typedef struct {
+    Window win;
+    Atom prop;
+    long max;                 /* items to fetch */
+    long *vals;               /* NULL if missing or not format 32 */
+    unsigned long n;
+} PropReq;
+
+/* a managed client and the desktop it is on (EWMH fallback) */
+typedef struct { Window win; int desk; } EwmhClient;
+
+/* shaped text: extents plus glyph specs, positioned for the last origin drawn at */
+typedef struct {
+    uint64_t key;             /* fingerprint of font + bytes */
+    XftFont *font;
+    char *text;               /* exact bytes, guards against fingerprint collisions */
+    size_t len;
+    XGlyphInfo ext;
+    XftGlyphFontSpec *glyphs;
+    int nglyphs;
+    int ox, oy;               /* origin the glyph positions currently include */
+    unsigned long last_use;   /* LRU clock, 0 = free slot */
+} TextLayout;
+
+/* a stretch of text in one style; points into the source string, never copied */
+typedef struct {
+    const char *s;
+    int len;
+    XftFont *font;
+    const XftColor *fg;       /* NULL = g_xft_fg */
+    const XftColor *bg;       /* NULL = bar background */
+    const char *act[CLICK_BUTTONS]; /* ^ca() command per button, into the source */
+    short act_len[CLICK_BUTTONS];
+    int x, w;                 /* offset from the segment start, advance */
+} TextRun;
+
+/* a text segment split at its inline markup */
+typedef struct {
+    TextRun run[MAX_RUNS];
+    int n;
+    int w;                    /* total advance */
+    const char *src;          /* what the runs were parsed from */
+    uint64_t fp;              /* font + bytes of src at that time */
+} TextRuns;
+
+/* markup color, allocated once per RGBA value */
+typedef struct { uint32_t rgba; int used; XftColor color; } ColorSlot;
+
+/* font named by ^font(), opened once; font NULL = failed, g_font is used */
+typedef struct { char name[64]; XftFont *font; } MarkupFont;
+
+/* clickable span of a bar, [x0, x1) in window coordinates: a workspace tag or
+   ^ca() text. cmd[k] is 1 + offset of button k+1's command in the bar's act_text */
+typedef struct {
+    int x0, x1;
+    int tag;                  /* 0 = not a tag */
+    unsigned short cmd[CLICK_BUTTONS];
+} ClickRegion;
+
+/* a separately measured and painted part of the bar */
+typedef struct {
+    uint64_t fp;       /* fingerprint of the inputs it was last measured from */
+    int measured;      /* fp and w are valid */
+    int w;             /* measured width */
+    int x, painted_w;  /* where the back buffer currently holds it; a cut or
+                          scrolling status is painted_w wide, not w */
+} Segment;
+
+enum { SEG_TAGS, SEG_STATUS, SEG_RIGHT, SEG_COUNT };
+
+/* one bar per output; font, colors, GCs and the text layout cache are shared */
+typedef struct {
+    unsigned long output;        /* RROutput, 0 = the whole screen */
+    int ox, oy, ow, oh;          /* output geometry */
+    Window win;
+    Pixmap back;                 /* back buffer, everything is rendered here first */
+    XftDraw *back_draw;
+    int back_w, back_h;
+    Segment segs[SEG_COUNT];
+    int frame_valid;             /* back buffer holds a complete frame */
+    uint64_t frame_geom;         /* geometry/font fingerprint of that frame */
+    int frame_w;
+    int win_x, win_w, win_h;     /* requested geometry; configures only go out on change */
+    TagRect tagrects[MAX_WS];
+    int tagrects_n;
+    ClickRegion regions[MAX_REGIONS]; /* sorted by x0, rebuilt with the layout */
+    int regions_n;
+    char act_text[2 * MAX_TEXT];      /* commands of the regions, copied out of the text */
+    size_t act_len;
+    int marquee;                 /* the status does not fit and scrolls */
+    int marquee_off;             /* how far it has scrolled, 0 .. status width + MARQUEE_GAP */
+} Bar;
+
+/* an output as XRandR reports it (or the whole screen) */
+typedef struct { unsigned long output; int x, y, w, h; } OutputGeom;
+
+/* reactor: fd handlers registered with epoll, and deadlines multiplexed onto one timerfd */
+typedef void (*IoFn)(void *ctx, unsigned int events);
+typedef struct {
+    int fd;
+    IoFn fn;
+    void *ctx;
+    int state;      /* 0 free, 1 live, 2 removed (slot reusable after the current batch) */
+} IoWatch;
+
+typedef struct {
+    uint64_t due;   /* CLOCK_MONOTONIC ms, 0 = disarmed */
+    void (*fn)(void *ctx);
+    void *ctx;
+} Timer;
+
+/* latency histogram in microseconds: log2 octaves split into HIST_SUB linear steps,
+   so a percentile is off by at most 1/HIST_SUB of its value */
+typedef struct {
+    uint32_t b[HIST_BUCKETS];
+    uint64_t n, sum, max;
+} Hist;
+
+/* draw_all phases, timed every frame */
+enum { PH_LAYOUT, PH_MEASURE, PH_XDRAW, PH_FLUSH, PH_COUNT };
+static const char *g_phase_names[PH_COUNT] = { "layout", "measure", "xdraw", "flush" };
+
+/* what asked for a frame */
+enum { TRIG_NONE = -1, TRIG_PIPE, TRIG_INOTIFY, TRIG_X, TRIG_TIMER, TRIG_IPC, TRIG_SHM, TRIG_COUNT };
+static const char *g_trigger_names[TRIG_COUNT] = { "pipe", "inotify", "x", "timer", "ipc", "shm" };
+
+/* ipc: a connected client; lines are handled as they complete */
+typedef struct {
+    int fd;               /* -1 = free slot */
+    IoWatch *watch;
+    char buf[MAX_TEXT + 64];
+    size_t len;
+    int overlong;         /* discarding until '\n' */
+} IpcClient;
+
+/* ipc: named text segment set by a client, shown after the right cmds */
+typedef struct {
+    char name[32];        /* "" = free slot */
+    char text[MAX_TEXT];
+} IpcSeg;
+
+/* fire-and-forget child; fn (if set) gets its wait status once it is reaped */
+typedef struct {
+    pid_t pid;      /* 0 = free slot */
+    void (*fn)(void *ctx, int status);
+    void *ctx;
+} BgProc;
+
+/* streaming reader for a line oriented pipe: bytes land in a ring and only the
+   newest complete line is published. a line longer than MAX_TEXT - 1 keeps its
+   first MAX_TEXT - 1 bytes, the rest up to its newline is discarded */
+typedef struct {
+    char ring[LINE_RING_SIZE];
+    size_t head;        /* stream offset of the next byte to store */
+    size_t line_start;  /* stream offset where the pending (incomplete) line starts */
+    int overlong;       /* pending line hit the cap, discarding until '\n' */
+} LineReader;
+
+/* built-in module instance; fds are opened once and re-read with pread */
+typedef struct Module Module;
+typedef struct {
+    const char *name;
+    int interval;                                    /* default refresh, seconds */
+    int (*open)(Module *m);                          /* returns 0 if unavailable */
+    void (*update)(Module *m, char *out, size_t outlen);
+} ModuleDef;
+
+struct Module {
+    const ModuleDef *def;
+    char arg[64];
+    int interval;
+    int fd[2];
+    unsigned long long prev[2];  /* net: last rx/tx byte counters */
+    struct timespec prev_ts;
+};
+
+/* one scheduled right command: runs as a nonblocking child, last output cached */
+typedef struct {
+    char *cmd;
+    Module *mod;           /* built-in module, NULL for shell commands */
+    int interval;          /* seconds, 0 = run once */
+    pid_t pid;             /* running child, -1 if none */
+    int fd;                /* read end while child output is pending, -1 otherwise */
+    char buf[MAX_TEXT];    /* output collected from the running child */
+    size_t len;
+    char out[MAX_TEXT];    /* cached first line of the last finished run */
+    Timer timer;           /* next run, disarmed = never again */
+    IoWatch *watch;        /* fd registration while output is pending */
+} RightCmd;
+
+/* runtime configuration: the HARD_* defaults with the config file applied */
+typedef struct {
+    char cmd[MAX_TEXT];
+    int interval;
+} RightCmdConf;
+
+typedef struct {
+    char font[128];
+    char bg[64], fg[64], focus_bg[64];
+    char status[MAX_TEXT];
+    char switch_cmd[256];
+    int interval, max_fps, bar_height, workspaces, fullscreen, marquee;
+    RightCmdConf right[MAX_RIGHT_CMDS];
+    int right_n;
+} Config;
+
 /* ---------------- global-ish state ---------------- */
 static Display *g_dpy = NULL;
 static int g_scr = 0;
 static Window g_root;
 static Colormap g_cmap;
-static int g_screen_w;
 static int g_bar_h = HARD_BAR_HEIGHT;
-static XftFont *g_font = NULL;
-static XftDraw *g_draw = NULL;
+static XftFont *g_font = NULL;     /* NULL until the font worker is done */
+static int g_font_efd = -1;         /* font worker finished */
+static pthread_t g_font_thread;
+static uint64_t g_font_worker_us = 0;
+static Bar g_bars[MAX_BARS];
+static int g_bars_n = 0;
+static int g_rr_event = -1;         /* XRandR event base, -1 = no XRandR */
+static unsigned long g_frames_painted = 0, g_frames_skipped = 0;
+
+/* stats: always on; monotonic timings into fixed histograms plus counters.
+   dumped as JSON on SIGUSR1, an ipc "stats" query, or on exit with --stats */
+static Hist g_hist_draw;
+static Hist g_hist_phase[PH_COUNT];
+static uint64_t g_phase_us[PH_COUNT];  /* current frame, summed over bars */
+static Hist g_hist_spawn, g_hist_read;
+static unsigned long g_triggers[TRIG_COUNT];
+static unsigned long g_spawns = 0;
+static uint64_t g_start_ms = 0;
+static const char *g_stats_path = NULL;
+static int g_profile_startup = 0;   /* --profile-startup: phase times, exit after the first frame */
+static uint64_t g_prof_start = 0, g_prof_last = 0; /* us */
+
+/* frame pacing: inputs only request a frame, the loop renders at most one per interval */
+static int g_frame_pending = 0;
+static uint64_t g_frame_interval = 1000 / HARD_MAX_FPS; /* ms */
+static uint64_t g_last_frame = 0;
+static Timer g_frame_timer;
+static unsigned long g_updates_rendered = 0;  /* frames rendered for requests */
+static unsigned long g_updates_coalesced = 0; /* requests merged while draining one wakeup */
+static unsigned long g_updates_dropped = 0;   /* requests superseded while the cap held a frame back */
+static TextLayout g_text_cache[TEXT_CACHE_SIZE];
+static unsigned long g_text_clock = 0;
+static unsigned long g_text_hits = 0, g_text_misses = 0;
+static TextRuns g_status_runs, g_right_runs;
+static ColorSlot g_color_cache[COLOR_CACHE_SIZE];
+static unsigned long g_color_hits = 0, g_color_misses = 0;
+static MarkupFont g_markup_fonts[MAX_MARKUP_FONTS];
+static int g_tag_w[MAX_WS + 1]; /* advance of each tag number, measured once per font */
+static const char *g_ellipsis = "...";  /* U+2026 if the font has it */
+static int g_ellipsis_w = 0;
+static int g_marquee = HARD_MARQUEE;    /* px/s, 0 = ellipsis */
+static Timer g_marquee_timer;
+static uint64_t g_marquee_last = 0;     /* ms the scroll offsets are current for */
+static unsigned long g_marquee_steps = 0;
+
+static Atom g_atoms[AtomLast];
+
+/* EWMH state, kept current from PropertyNotify on the root and on clients */
+static int g_ewmh_current = -1;       /* 1-based focused workspace, -1 unknown */
+static int g_ewmh_ndesktops = 0;
+static EwmhClient *g_clients = NULL;  /* sorted by window */
+static int g_clients_n = 0;
+static int g_desk_clients[MAX_WS + 1]; /* clients per 1-based workspace */
+
+/* optimistic switch: the requested workspace is shown focused until the wm reports */
+static int g_switch_pending = 0;
+static Timer g_switch_timer;
+static Time g_input_time = CurrentTime; /* timestamp of the last click, for EWMH requests */
+
+/* blocking round trips issued while drawing (diagnostic) */
+static unsigned long g_rt_frame = 0, g_rt_last = 0, g_rt_total = 0;
+#define ROUNDTRIP() (g_rt_frame++)
+static XRectangle g_damage[MAX_DAMAGE];
+static int g_damage_n = 0;
 static XftColor g_xft_fg, g_xft_shadow, g_xft_focus_text;
 static XColor g_xc_bg, g_xc_fg, g_xc_focus;
 static unsigned long g_bg_pixel;
-static Window g_win;
-static TagRect g_tagrects[MAX_WS];
-static int g_tagrects_n = 0;
 static int g_ws_count = HARD_WS_COUNT;
-static char g_focused_path[PATH_MAX] = "";
-static char g_occupied_path[PATH_MAX] = "";
+static char g_home_path[PATH_MAX] = "";
+static char g_wm_dir[PATH_MAX] = "";   /* ~/.wm, watched as a directory */
+static int g_ino_fd = -1;
+static int g_home_wd = -1, g_wm_wd = -1;
+
+/* state files the wm writes into ~/.wm; fds stay open until the file is replaced */
+typedef struct { const char *name; int fd; } WmFile;
+enum { WM_FOCUSED, WM_OCCUPIED, WM_FILE_COUNT };
+static WmFile g_wm_files[WM_FILE_COUNT] = {
+    { "focused.workspace", -1 },
+    { "occupied.workspace", -1 },
+};
+static int g_wm_focused = 0;            /* from focused.workspace, 0 = absent */
+static unsigned int g_wm_occupied = 0;  /* from occupied.workspace (bit i = workspace i) */
+static int g_wm_occupied_valid = 0;     /* occupied.workspace exists */
+
+/* ipc socket; focus and occupied land in the g_wm_* state above, the last writer wins */
+static int g_ipc_fd = -1;
+static struct sockaddr_un g_ipc_addr;
+static socklen_t g_ipc_addr_len = 0;
+static IpcClient g_ipc_clients[MAX_IPC_CLIENTS];
+static IpcSeg g_ipc_segs[MAX_IPC_SEGS];
+
+/* shared-memory segment table handed to producers over ipc; the bar only keeps
+   a copy of each segment, refreshed when its sequence moved */
+static hsdbar_shm *g_shm = NULL;
+static int g_shm_fd = -1, g_shm_efd = -1;
+static char g_shm_text[HSDBAR_SHM_SEGS][HSDBAR_SHM_TEXT];
+static uint32_t g_shm_seen[HSDBAR_SHM_SEGS];
 static const char *g_cmd = HARD_CMD;
 static const char *g_switch_fmt = NULL; /* keep NULL: hardcode if you want */
 static GC g_gc_bg = NULL;
 static GC g_gc_focus = NULL;
 static int g_fullscreen = HARD_FULLSCREEN;
-static char *g_right_cmds[MAX_RIGHT_CMDS];
+static RightCmd g_right_cmds[MAX_RIGHT_CMDS];
 static int g_right_cmds_n = 0;
 
 /* status command runtime state */
 static pid_t g_cmd_pid = -1;
 static int g_cmd_fd = -1; /* read end */
 static char g_status_line[MAX_TEXT] = "";
-static char g_cmd_readbuf[4096];
-static size_t g_cmd_readpos = 0;
-static time_t g_next_spawn = 0;
+static LineReader g_cmd_reader;
+static int g_status_interval = HARD_INTERVAL; /* seconds */
+static Timer g_status_timer;        /* respawn / module refresh deadline */
+static IoWatch *g_cmd_watch = NULL;
+
+/* status command supervision: own process group, exit seen through a pidfd */
+static int g_cmd_pidfd = -1;
+static IoWatch *g_cmd_pid_watch = NULL;
+static uint64_t g_cmd_started = 0;  /* monotonic ms of the current run */
+static int g_cmd_backoff = 0;       /* current crash restart delay, seconds */
+static int g_cmd_kill_sent = 0;     /* 0 none, 1 SIGTERM, 2 SIGKILL */
+static struct { pid_t pgid; uint64_t due; } g_cmd_doomed[4]; /* groups sent SIGTERM, SIGKILL at due */
+static Timer g_cmd_doomed_timer;
+static unsigned long g_cmd_spawns = 0, g_cmd_restarts = 0, g_cmd_crashes = 0;
+static Module *g_status_mod = NULL; /* HARD_CMD is a built-in module */
+
+/* runtime config */
+static Config g_cfg;
+static char g_cfg_dir[PATH_MAX] = "";  /* watched on g_ino_fd if it exists */
+static char g_cfg_path[PATH_MAX + 8] = "";
+static int g_cfg_wd = -1;
+static int g_cfg_parent_wd = -1;        /* until g_cfg_dir exists, its parent is watched */
+static const char *g_status_override = NULL; /* --status-cmd beats the file */
+
+/* reactor state */
+static int g_epfd = -1, g_timerfd = -1, g_sigfd = -1;
+static IoWatch g_watches[MAX_WATCHES];
+static Timer *g_timers[MAX_TIMERS];
+static int g_timers_n = 0;
+static uint64_t g_timerfd_due = 0;  /* what the timerfd is armed for, 0 = disarmed */
+static sigset_t g_orig_sigmask;     /* restored in children */
+static BgProc g_bg_procs[MAX_BG_PROCS];
+static int g_running = 1;
+
+/* module instances: one per right cmd plus the status line */
+static Module g_modules[MAX_RIGHT_CMDS + 1];
+static int g_modules_n = 0;
 
 /* forward */
 static void draw_all(void);
+static void request_frame(int src);
+static void render_frame(int src);
+static Bar *bar_find(Window w);
 static void do_switch(int ws);
-static void set_strut(Display *dpy, Window win, int top);
+static void switch_settle(void);
+static void set_strut(Display *dpy, Window win, int top, int x0, int x1);
 static int spawn_status_cmd(void);
 static void stop_status_cmd_and_schedule_restart(int status_interval);
+static void reap_children(void);
+static void dump_stats(void);
+static void config_reload(void);
+static void config_watch(void);
 
-/* helper run system with formatted string (safe-ish) */
-static void run_format(const char *fmt, ...) {
-    if (!fmt) return;
-    char buf[256];
-    va_list ap;
-    va_start(ap, fmt);
-    vsnprintf(buf, sizeof(buf), fmt, ap);
-    va_end(ap);
-    if (buf[0]) system(buf);
-}
-
-/* run a command and store at most outlen-1 bytes in out */
-static void run_cmd_to_buf(const char *cmd, char *out, size_t outlen) {
-    if (!cmd || !out || outlen == 0) return;
-    FILE *f = popen(cmd, "r");
-    if (!f) { out[0] = '\0'; return; }
-    if (!fgets(out, (int)outlen, f)) out[0] = '\0';
-    size_t L = strlen(out);
-    if (L && out[L-1] == '\n') out[L-1] = '\0';
-    pclose(f);
-}
-
-/* eWMH current desktop */
-static int get_ewmh_current_desktop(Display *dpy) {
-    Atom a = XInternAtom(dpy, "_NET_CURRENT_DESKTOP", False);
-    if (!a) return -1;
-    Atom type; int format; unsigned long nitems, after;
-    unsigned char *data = NULL;
-    int res = XGetWindowProperty(dpy, DefaultRootWindow(dpy), a, 0, 1, False, AnyPropertyType,
-                                 &type, &format, &nitems, &after, &data);
-    if (res != Success || !data) return -1;
-    long v = ((long*)data)[0];
-    XFree(data);
-    return (int)v + 1;
+/* ---------------- reactor ---------------- */
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
 }
 
-static int parse_color(Display *dpy, Colormap cmap, const char *spec, XColor *out) {
-    XColor tmp;
-    if (!spec) return 0;
-    if (!XParseColor(dpy, cmap, spec, &tmp)) return 0;
-    if (!XAllocColor(dpy, cmap, &tmp)) return 0;
-    *out = tmp;
-    return 1;
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
 }
 
-static double lum_from_xcolor(const XColor *xc) {
-    double r = (double)xc->red / 65535.0;
-    double g = (double)xc->green / 65535.0;
-    double b = (double)xc->blue / 65535.0;
-    return 0.2126 * r + 0.7152 * g + 0.0722 * b;
+static IoWatch *io_add(int fd, IoFn fn, void *ctx) {
+    for (int i = 0; i < MAX_WATCHES; ++i) {
+        IoWatch *w = &g_watches[i];
+        if (w->state != 0) continue;
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = w;
+        if (epoll_ctl(g_epfd, EPOLL_CTL_ADD, fd, &ev) < 0) return NULL;
+        w->fd = fd;
+        w->fn = fn;
+        w->ctx = ctx;
+        w->state = 1;
+        return w;
+    }
+    return NULL;
 }
 
-/* convenience: allocate an XftColor from an XColor; returns 1 on success */
-static int alloc_xft_from_xcolor(Display *dpy, Visual *vis, Colormap cmap, const XColor *xc, XftColor *out) {
-    XRenderColor rc;
-    rc.red   = (unsigned short)xc->red;
-    rc.green = (unsigned short)xc->green;
-    rc.blue  = (unsigned short)xc->blue;
-    rc.alpha = 0xffff;
-    if (XftColorAllocValue(dpy, vis, cmap, &rc, out)) return 1;
+/* unregister before closing fd; the slot stays reserved until the current batch is done
+   so a stale event for it in the same epoll_wait result is ignored */
+static void io_del(IoWatch *w) {
+    if (!w || w->state != 1) return;
+    epoll_ctl(g_epfd, EPOLL_CTL_DEL, w->fd, NULL);
+    w->state = 2;
+}
 
-    /* fallback: try pure black or white based on xc brightness */
-    double lum = lum_from_xcolor(xc);
-    if (lum > 0.5) {
-        XRenderColor rb = { 0, 0, 0, 0xffff };
-        return XftColorAllocValue(dpy, vis, cmap, &rb, out);
-    } else {
-        XRenderColor rw = { 0xffff, 0xffff, 0xffff, 0xffff };
-        return XftColorAllocValue(dpy, vis, cmap, &rw, out);
-    }
+static void io_reap(void) {
+    for (int i = 0; i < MAX_WATCHES; ++i)
+        if (g_watches[i].state == 2) g_watches[i].state = 0;
 }
 
-/* implementation: set _NET_WM_STRUT and _NET_WM_STRUT_PARTIAL so the dock reserves space */
-static void set_strut(Display *dpy, Window win, int top) {
-    Atom a_strut = XInternAtom(dpy, "_NET_WM_STRUT", False);
-    Atom a_strut_partial = XInternAtom(dpy, "_NET_WM_STRUT_PARTIAL", False);
-    if (!a_strut || !a_strut_partial) return;
+static void timer_init(Timer *t, void (*fn)(void *ctx), void *ctx) {
+    t->due = 0;
+    t->fn = fn;
+    t->ctx = ctx;
+    if (g_timers_n < MAX_TIMERS) g_timers[g_timers_n++] = t;
+}
 
-    long strut[4] = {0, 0, top, 0};
-    long partial[12] = {0};
-    partial[2] = top;
-    XChangeProperty(dpy, win, a_strut, XA_CARDINAL, 32, PropModeReplace, (unsigned char*)strut, 4);
-    XChangeProperty(dpy, win, a_strut_partial, XA_CARDINAL, 32, PropModeReplace, (unsigned char*)partial, 12);
+static void timer_arm(Timer *t, uint64_t due) {
+    t->due = due ? due : 1;
 }
 
-/* switch workspace: format command with %d if provided, else try wmctrl fallback, then xdotool fallback */
-static void do_switch(int ws) {
-    if (ws < 1) return;
-    if (g_switch_fmt && strchr(g_switch_fmt, '%')) {
-        char cmdbuf[256];
-        int n = snprintf(cmdbuf, sizeof(cmdbuf), g_switch_fmt, ws);
-        if (n > 0 && n < (int)sizeof(cmdbuf)) {
-            system(cmdbuf);
-            return;
-        }
+static void timer_cancel(Timer *t) {
+    t->due = 0;
+}
+
+/* point the timerfd at the earliest armed deadline (or disarm it) */
+static void timers_sync(void) {
+    uint64_t due = 0;
+    for (int i = 0; i < g_timers_n; ++i)
+        if (g_timers[i]->due && (!due || g_timers[i]->due < due)) due = g_timers[i]->due;
+    if (due == g_timerfd_due) return;
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (due) {
+        its.it_value.tv_sec = (time_t)(due / 1000);
+        its.it_value.tv_nsec = (long)(due % 1000) * 1000000L;
     }
-    char try1[64];
-    snprintf(try1, sizeof(try1), "wmctrl -s %d >/dev/null 2>&1", ws - 1);
-    if (system(try1) == 0) return;
-    char try2[64];
-    snprintf(try2, sizeof(try2), "xdotool key super+%d >/dev/null 2>&1", ws % 10);
-    system(try2);
+    timerfd_settime(g_timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+    g_timerfd_due = due;
 }
 
-/* spawn the status command with a pipe, nonblocking read end */
-static int spawn_status_cmd(void) {
-    if (!g_cmd || !g_cmd[0]) return 0;
-    int p[2];
-    if (pipe(p) < 0) {
-        return 0;
+static void timers_io(void *ctx, unsigned int events) {
+    (void)ctx; (void)events;
+    uint64_t expirations;
+    if (read(g_timerfd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) return;
+    g_timerfd_due = 0;
+    uint64_t now = now_ms();
+    for (int i = 0; i < g_timers_n; ++i) {
+        Timer *t = g_timers[i];
+        if (!t->due || t->due > now) continue;
+        t->due = 0;
+        t->fn(t->ctx);
     }
+}
 
-    pid_t pid = fork();
-    if (pid < 0) {
-        close(p[0]); close(p[1]);
-        return 0;
+static void signal_io(void *ctx, unsigned int events) {
+    (void)ctx; (void)events;
+    struct signalfd_siginfo si;
+    while (read(g_sigfd, &si, sizeof(si)) == (ssize_t)sizeof(si)) {
+        switch (si.ssi_signo) {
+        case SIGCHLD: reap_children(); break;
+        case SIGUSR1: dump_stats(); break;
+        case SIGINT:
+        case SIGTERM: g_running = 0; break;
+        }
     }
+}
 
-    if (pid == 0) {
-        /* child */
-        /* detach stdout (and stderr) to the pipe */
-        close(p[0]);
-        if (dup2(p[1], STDOUT_FILENO) < 0) _exit(127);
-        if (dup2(p[1], STDERR_FILENO) < 0) { /* ignore */ }
-        close(p[1]);
+/* signals are only delivered through the signalfd; children get the original mask back */
+static int reactor_init(void) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGUSR1);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, &g_orig_sigmask);
 
-        /* ensure we don't inherit fds we shouldn't - optional, but good */
-        for (int fd = 3; fd < 256; ++fd) close(fd);
+    g_epfd = epoll_create1(EPOLL_CLOEXEC);
+    g_timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    g_sigfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (g_epfd < 0 || g_timerfd < 0 || g_sigfd < 0) return 0;
+    io_add(g_timerfd, timers_io, NULL);
+    io_add(g_sigfd, signal_io, NULL);
+    return 1;
+}
 
-        /* run via sh -c */
-        execl("/bin/sh", "sh", "-c", g_cmd, (char*)NULL);
-        _exit(127);
-    }
+static void reactor_close(void) {
+    if (g_sigfd >= 0) close(g_sigfd);
+    if (g_timerfd >= 0) close(g_timerfd);
+    if (g_epfd >= 0) close(g_epfd);
+}
 
-    /* parent */
-    close(p[1]);
-    /* make nonblocking */
-    int flags = fcntl(p[0], F_GETFL, 0);
-    if (flags >= 0) fcntl(p[0], F_SETFL, flags | O_NONBLOCK);
+/* ---------------- stats ---------------- */
 
-    g_cmd_pid = pid;
-    g_cmd_fd = p[0];
-    g_cmd_readpos = 0;
-    g_cmd_readbuf[0] = '\0';
-    g_status_line[0] = '\0';
-    return 1;
+static int hist_bucket(uint64_t us) {
+    if (us < HIST_SUB) return (int)us;
+    int octave = 63 - __builtin_clzll(us);            /* >= log2(HIST_SUB) */
+    int sub = (int)(us >> (octave - 3)) & (HIST_SUB - 1);
+    int i = (octave - 2) * HIST_SUB + sub;
+    return i < HIST_BUCKETS ? i : HIST_BUCKETS - 1;
 }
 
-/* stop existing cmd (if any) and schedule restart after interval seconds */
-static void stop_status_cmd_and_schedule_restart(int status_interval) {
-    if (g_cmd_fd >= 0) {
-        close(g_cmd_fd);
-        g_cmd_fd = -1;
-    }
-    if (g_cmd_pid > 0) {
-        int st = 0;
-        waitpid(g_cmd_pid, &st, WNOHANG);
-        g_cmd_pid = -1;
-    }
-    g_next_spawn = time(NULL) + (status_interval > 0 ? status_interval : 1);
-}
-
-/* internal helper to process bytes read from cmd pipe and update g_status_line when we have a full line */
-static void process_cmd_bytes(const char *buf, ssize_t n) {
-    if (!buf || n <= 0) return;
-    size_t space = sizeof(g_cmd_readbuf) - g_cmd_readpos - 1;
-    if ((size_t)n > space) n = (ssize_t)space;
-    memcpy(g_cmd_readbuf + g_cmd_readpos, buf, n);
-    g_cmd_readpos += n;
-    g_cmd_readbuf[g_cmd_readpos] = '\0';
-
-    /* extract last full line (up to newline) */
-    char *last_nl = strrchr(g_cmd_readbuf, '\n');
-    if (!last_nl) {
-        /* no newline yet, don't update g_status_line (unless buffer too full) */
-        if (g_cmd_readpos >= sizeof(g_cmd_readbuf) - 2) {
-            /* force update with what we have */
-            size_t L = g_cmd_readpos;
-            if (L >= sizeof(g_status_line)) L = sizeof(g_status_line) - 1;
-            memcpy(g_status_line, g_cmd_readbuf, L);
-            g_status_line[L] = '\0';
-            /* reset buffer */
-            g_cmd_readpos = 0;
-            g_cmd_readbuf[0] = '\0';
-        }
-        return;
+/* smallest value that lands in bucket i + 1, i.e. bucket i's upper bound */
+static uint64_t hist_bucket_top(int i) {
+    if (i < HIST_SUB) return (uint64_t)i + 1;
+    int octave = i / HIST_SUB + 2, sub = i % HIST_SUB;
+    return ((uint64_t)(HIST_SUB + sub + 1)) << (octave - 3);
+}
+
+static void hist_add(Hist *h, uint64_t us) {
+    h->b[hist_bucket(us)]++;
+    h->n++;
+    h->sum += us;
+    if (us > h->max) h->max = us;
+}
+
+/* q in 0..1; upper bound of the bucket holding that quantile */
+static uint64_t hist_pct(const Hist *h, double q) {
+    if (!h->n) return 0;
+    uint64_t want = (uint64_t)(q * (double)h->n + 0.5), seen = 0;
+    if (want < 1) want = 1;
+    for (int i = 0; i < HIST_BUCKETS; ++i)
+        if ((seen += h->b[i]) >= want) return MIN(hist_bucket_top(i), h->max);
+    return h->max;
+}
+
+static void hist_json(FILE *f, const char *name, const Hist *h) {
+    fprintf(f, "\"%s\":{\"count\":%llu,\"mean\":%.1f,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu}",
+            name, (unsigned long long)h->n, h->n ? (double)h->sum / h->n : 0.0,
+            (unsigned long long)hist_pct(h, 0.5), (unsigned long long)hist_pct(h, 0.9),
+            (unsigned long long)hist_pct(h, 0.99), (unsigned long long)h->max);
+}
+
+/* --profile-startup: time since the previous mark and since main() started */
+static void startup_mark(const char *phase) {
+    if (!g_profile_startup) return;
+    uint64_t t = now_us();
+    fprintf(stderr, "startup %-16s %8.2f ms  (at %8.2f ms)\n", phase,
+            (double)(t - g_prof_last) / 1000.0, (double)(t - g_prof_start) / 1000.0);
+    g_prof_last = t;
+}
+
+/* ---------------- spawning ---------------- */
+
+extern char **environ;
+
+/* split cmd on blanks into argv inside buf. returns argc, or 0 if cmd uses
+   anything only a shell understands (quoting, pipes, globs, $vars, ...) */
+static int spawn_split(const char *cmd, char *buf, size_t len, char **argv, int max) {
+    if (!cmd || strlen(cmd) >= len || strpbrk(cmd, "|&;<>()$`\\\"'*?[]{}~#=\n")) return 0;
+    strcpy(buf, cmd);
+    int argc = 0;
+    for (char *t = strtok(buf, " \t"); t; t = strtok(NULL, " \t")) {
+        if (argc == max) return 0;
+        argv[argc++] = t;
     }
+    argv[argc] = NULL;
+    return argc;
+}
 
-    /* take the last full line: find previous newline (or start) */
-    char *prev = last_nl;
-    if (prev != g_cmd_readbuf) {
-        char *p = prev - 1;
-        while (p >= g_cmd_readbuf && *p != '\n') --p;
-        if (p >= g_cmd_readbuf && *p == '\n') prev = p + 1;
-        else prev = g_cmd_readbuf;
-    } else {
-        prev = g_cmd_readbuf;
+#if !(defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34)))
+#ifndef CLOSE_RANGE_CLOEXEC
+#define CLOSE_RANGE_CLOEXEC (1U << 2)
+#endif
+/* no closefrom file action: mark every fd beyond stderr CLOEXEC instead, so
+   nothing a library opened without it leaks into children. close_range where
+   the kernel has it, else walk /proc/self/fd */
+static void spawn_fds_cloexec(void) {
+#ifdef SYS_close_range
+    if (syscall(SYS_close_range, 3u, ~0u, CLOSE_RANGE_CLOEXEC) == 0) return;
+#endif
+    DIR *d = opendir("/proc/self/fd");
+    if (!d) return;
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        int fd = atoi(de->d_name);
+        if (fd < 3 || fd == dirfd(d)) continue;
+        int fl = fcntl(fd, F_GETFD);
+        if (fl >= 0 && !(fl & FD_CLOEXEC)) fcntl(fd, F_SETFD, fl | FD_CLOEXEC);
     }
+    closedir(d);
+}
+#endif
 
-    /* copy the last full line (strip newline) */
-    size_t len = (size_t)(last_nl - prev);
-    if (len >= sizeof(g_status_line)) len = sizeof(g_status_line) - 1;
-    memcpy(g_status_line, prev, len);
-    g_status_line[len] = '\0';
+/* spawn argv (path searched) with stdout on out_fd (-1 = /dev/null), stderr on
+   err_fd (-1 = /dev/null) and stdin from /dev/null. posix_spawn gives vfork
+   semantics; fds beyond stderr are closed in the child (closefrom where libc
+   has it, otherwise they are all made CLOEXEC first).
+   pgroup: the child leads its own process group. returns the pid or -1 */
+static pid_t spawn_argv(char **argv, int out_fd, int err_fd, int pgroup) {
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawnattr_init(&attr);
 
-    /* if there is data after last_nl, shift it to the buffer start */
-    size_t remain = (size_t)(g_cmd_readpos - (last_nl - g_cmd_readbuf) - 1);
-    if (remain > 0) {
-        memmove(g_cmd_readbuf, last_nl + 1, remain);
-        g_cmd_readpos = remain;
-        g_cmd_readbuf[g_cmd_readpos] = '\0';
-    } else {
-        g_cmd_readpos = 0;
-        g_cmd_readbuf[0] = '\0';
+    posix_spawn_file_actions_addopen(&fa, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    if (out_fd >= 0) posix_spawn_file_actions_adddup2(&fa, out_fd, STDOUT_FILENO);
+    else posix_spawn_file_actions_addopen(&fa, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    if (err_fd >= 0) posix_spawn_file_actions_adddup2(&fa, err_fd, STDERR_FILENO);
+    else posix_spawn_file_actions_addopen(&fa, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+    posix_spawn_file_actions_addclosefrom_np(&fa, 3);
+#else
+    spawn_fds_cloexec();
+#endif
+
+    /* children get the signal mask we had before blocking for signalfd */
+    short flags = POSIX_SPAWN_SETSIGMASK;
+    posix_spawnattr_setsigmask(&attr, &g_orig_sigmask);
+    if (pgroup) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, 0);
     }
+    posix_spawnattr_setflags(&attr, flags);
+
+    pid_t pid;
+    uint64_t t0 = now_us();
+    int r = posix_spawnp(&pid, argv[0], &fa, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    posix_spawnattr_destroy(&attr);
+    hist_add(&g_hist_spawn, now_us() - t0);
+    if (r == 0) g_spawns++;
+    return r == 0 ? pid : -1;
 }
 
-/* ---------------- draw_all ---------------- */
-static void draw_all(void) {
-    if (!g_dpy) return;
+/* run cmd like spawn_argv: simple commands are exec'd directly, the rest via sh -c */
+static pid_t spawn_cmd(const char *cmd, int out_fd, int err_fd, int pgroup) {
+    if (!cmd || !cmd[0]) return -1;
+    char buf[MAX_TEXT];
+    char *argv[SPAWN_MAX_ARGS + 1];
+    char *sh_argv[] = { "/bin/sh", "-c", (char*)cmd, NULL };
+    int direct = spawn_split(cmd, buf, sizeof(buf), argv, SPAWN_MAX_ARGS);
+    return spawn_argv(direct ? argv : sh_argv, out_fd, err_fd, pgroup);
+}
 
-    char status_text[MAX_TEXT] = "";
-    /* use the latest line we have from the spawned command */
-    if (g_status_line[0]) {
-        strncpy(status_text, g_status_line, sizeof(status_text)-1);
-        status_text[sizeof(status_text)-1] = '\0';
-    }
-
-    /* build right text by running each right cmd and joining with two spaces */
-    char right_text[MAX_TEXT] = "";
-    if (g_right_cmds_n > 0) {
-        char tmp[MAX_TEXT];
-        for (int i = 0; i < g_right_cmds_n; ++i) {
-            tmp[0] = '\0';
-            run_cmd_to_buf(g_right_cmds[i], tmp, sizeof(tmp));
-            if (tmp[0]) {
-                if (right_text[0]) strncat(right_text, "  ", sizeof(right_text) - strlen(right_text) - 1);
-                strncat(right_text, tmp, sizeof(right_text) - strlen(right_text) - 1);
-            }
-        }
-    }
+/* spawn cmd in the background with output discarded; fn gets its exit status */
+static pid_t spawn_bg(const char *cmd, void (*fn)(void *ctx, int status), void *ctx) {
+    BgProc *slot = NULL;
+    for (int i = 0; i < MAX_BG_PROCS && !slot; ++i)
+        if (!g_bg_procs[i].pid) slot = &g_bg_procs[i];
+    if (!slot) return -1;
+    pid_t pid = spawn_cmd(cmd, -1, -1, 0);
+    if (pid < 0) return -1;
+    slot->pid = pid;
+    slot->fn = fn;
+    slot->ctx = ctx;
+    return pid;
+}
 
-    /* focused workspace -> prefer file, else EWMH */
-    int focused_ws = 1;
-    char fb[32] = "";
-    FILE *f = NULL;
-    if (g_focused_path[0]) {
-        f = fopen(g_focused_path, "r");
-        if (f) {
-            if (fgets(fb, sizeof(fb), f)) {
-                size_t L = strlen(fb);
-                if (L && fb[L-1] == '\n') fb[L-1] = '\0';
-            }
-            fclose(f);
-        }
+/* hand an already running child to the bg table so SIGCHLD reaps it */
+static void bg_adopt(pid_t pid) {
+    for (int i = 0; i < MAX_BG_PROCS; ++i) {
+        if (g_bg_procs[i].pid) continue;
+        g_bg_procs[i].pid = pid;
+        g_bg_procs[i].fn = NULL;
+        g_bg_procs[i].ctx = NULL;
+        return;
     }
-    if (fb[0]) focused_ws = atoi(fb);
-    else {
-        int e = get_ewmh_current_desktop(g_dpy);
-        if (e > 0) focused_ws = e;
+    waitpid(pid, NULL, WNOHANG); /* table full: best effort */
+}
+
+static void bg_reap(void) {
+    int st;
+    for (int i = 0; i < MAX_BG_PROCS; ++i) {
+        BgProc *b = &g_bg_procs[i];
+        if (!b->pid || waitpid(b->pid, &st, WNOHANG) == 0) continue;
+        b->pid = 0;
+        if (b->fn) b->fn(b->ctx, st);
     }
-    if (focused_ws < 1) focused_ws = 1;
-    if (focused_ws > g_ws_count) focused_ws = g_ws_count;
-
-    int occupied[MAX_WS + 1] = {0};
-    if (g_occupied_path[0]) {
-        char occ[256] = "";
-        FILE *fo = fopen(g_occupied_path, "r");
-        if (fo) {
-            size_t idx = 0; int c;
-            while ((c = fgetc(fo)) != EOF && idx + 1 < sizeof(occ)) occ[idx++] = (char)c;
-            occ[idx] = '\0';
-            fclose(fo);
-        }
-        char *p = occ;
-        while (*p) {
-            while (*p && !isdigit((unsigned char)*p)) ++p;
-            if (!*p) break;
-            char *end = NULL;
-            long v = strtol(p, &end, 10);
-            if (end == p) break;
-            if (v >= 1 && v <= g_ws_count) occupied[v] = 1;
-            p = end;
-        }
-    }
-    occupied[focused_ws] = 1;
+}
 
-    /* measure tags widths */
-    int x = PADDING;
-    g_tagrects_n = 0;
+/* ---------------- built-in modules ---------------- */
 
-    for (int i = 1; i <= g_ws_count; ++i) {
-        if (!occupied[i]) continue;
+/* re-read a file opened once from offset 0; returns bytes read, buf is NUL terminated */
+static ssize_t pread_text(int fd, char *buf, size_t len) {
+    if (fd < 0 || len == 0) return -1;
+    ssize_t r;
+    do r = pread(fd, buf, len - 1, 0); while (r < 0 && errno == EINTR);
+    buf[r > 0 ? r : 0] = '\0';
+    return r;
+}
 
-        char tb[4];
-        snprintf(tb, sizeof(tb), "%d", i);
-        XGlyphInfo ginfo;
-        XftTextExtentsUtf8(g_dpy, g_font, (FcChar8*)tb, strlen(tb), &ginfo);
-        int w = (int)ginfo.xOff + TAG_PADDING;
+static int open_ro(const char *path) {
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
 
-        if (g_tagrects_n < MAX_WS) {
-            g_tagrects[g_tagrects_n].x = x;
-            g_tagrects[g_tagrects_n].w = w;
-            g_tagrects[g_tagrects_n].tag = i;
-            g_tagrects_n++;
-        }
-        x += w + TAG_SPACING;
+/* human readable byte count, 1024 based */
+static void fmt_bytes(char *out, size_t outlen, double v) {
+    static const char units[] = "BKMGT";
+    int u = 0;
+    while (v >= 1024.0 && u < 4) { v /= 1024.0; ++u; }
+    if (u == 0 || v >= 100.0) snprintf(out, outlen, "%.0f%c", v, units[u]);
+    else snprintf(out, outlen, "%.1f%c", v, units[u]);
+}
+
+static int mod_clock_open(Module *m) {
+    if (!m->arg[0]) snprintf(m->arg, sizeof(m->arg), "%s", "%a %b %d %H:%M:%S");
+    /* only tick every second when the format actually shows seconds: render it
+       for two instants a second apart, mid-minute, and see if they differ.
+       catches %S %T %X %c %+ %E/%O forms and anything strftime adds later */
+    if (m->interval <= 0) {
+        time_t t = 1000000000 - 1000000000 % 60 + 20;
+        struct tm a, b;
+        char sa[128], sb[128];
+        localtime_r(&t, &a);
+        t++;
+        localtime_r(&t, &b);
+        size_t na = strftime(sa, sizeof(sa), m->arg, &a), nb = strftime(sb, sizeof(sb), m->arg, &b);
+        m->interval = na != nb || memcmp(sa, sb, na) != 0 ? 1 : 60;
     }
+    return 1;
+}
 
-    int left_width = x;
-    XGlyphInfo gstatus;
-    XftTextExtentsUtf8(g_dpy, g_font, (FcChar8*)status_text, strlen(status_text), &gstatus);
-    int status_w = (int)gstatus.xOff;
+static void mod_clock_update(Module *m, char *out, size_t outlen) {
+    time_t t = time(NULL);
+    struct tm tm;
+    localtime_r(&t, &tm);
+    if (!strftime(out, outlen, m->arg, &tm)) out[0] = '\0';
+}
 
-    XGlyphInfo gright;
-    XftTextExtentsUtf8(g_dpy, g_font, (FcChar8*)right_text, strlen(right_text), &gright);
-    int right_w = (int)gright.xOff;
+static int mod_uptime_open(Module *m) {
+    m->fd[0] = open_ro("/proc/uptime");
+    return m->fd[0] >= 0;
+}
 
-    /* compute content width including right area */
-    int content_w = left_width + status_w + right_w + PADDING * 3;
-    if (content_w < 200) content_w = 200;
+static void mod_uptime_update(Module *m, char *out, size_t outlen) {
+    char buf[64];
+    if (pread_text(m->fd[0], buf, sizeof(buf)) <= 0) { out[0] = '\0'; return; }
+    long secs = (long)strtod(buf, NULL);
+    long d = secs / 86400, h = (secs / 3600) % 24, mi = (secs / 60) % 60;
+    if (d > 0) snprintf(out, outlen, "up %ldd %ldh %ldm", d, h, mi);
+    else if (h > 0) snprintf(out, outlen, "up %ldh %ldm", h, mi);
+    else snprintf(out, outlen, "up %ldm", mi);
+}
 
-    g_screen_w = DisplayWidth(g_dpy, g_scr);
-    int win_x = (g_screen_w - content_w) / 2;
-    if (win_x < 0) win_x = 0;
+static int mod_load_open(Module *m) {
+    m->fd[0] = open_ro("/proc/loadavg");
+    return m->fd[0] >= 0;
+}
 
-    if (g_fullscreen) {
-        content_w = g_screen_w;
-        win_x = 0;
-    }
+static void mod_load_update(Module *m, char *out, size_t outlen) {
+    char buf[128];
+    double a = 0, b = 0, c = 0;
+    if (pread_text(m->fd[0], buf, sizeof(buf)) <= 0 ||
+        sscanf(buf, "%lf %lf %lf", &a, &b, &c) != 3) { out[0] = '\0'; return; }
+    snprintf(out, outlen, "load %.2f %.2f %.2f", a, b, c);
+}
 
-    XMoveResizeWindow(g_dpy, g_win, win_x, 0, content_w, g_bar_h);
-    XSync(g_dpy, False);
+static int mod_mem_open(Module *m) {
+    m->fd[0] = open_ro("/proc/meminfo");
+    return m->fd[0] >= 0;
+}
 
-    XFillRectangle(g_dpy, g_win, g_gc_bg, 0, 0, content_w, g_bar_h);
+/* value in kB of a "Key:   1234 kB" line, -1 if missing */
+static long long meminfo_kb(const char *buf, const char *key) {
+    const char *p = strstr(buf, key);
+    if (!p) return -1;
+    return strtoll(p + strlen(key), NULL, 10);
+}
 
-    int text_y = g_font->ascent + (g_bar_h - (g_font->ascent + g_font->descent)) / 2;
-    for (int i = 0; i < g_tagrects_n; ++i) {
-        int tag = g_tagrects[i].tag;
-        char tb[4];
-        snprintf(tb, sizeof(tb), "%d", tag);
-        int tx = g_tagrects[i].x;
-        int w = g_tagrects[i].w;
+static void mod_mem_update(Module *m, char *out, size_t outlen) {
+    char buf[4096];
+    if (pread_text(m->fd[0], buf, sizeof(buf)) <= 0) { out[0] = '\0'; return; }
+    long long total = meminfo_kb(buf, "MemTotal:");
+    long long avail = meminfo_kb(buf, "MemAvailable:");
+    if (total <= 0 || avail < 0) { out[0] = '\0'; return; }
+    char used_s[16], total_s[16];
+    fmt_bytes(used_s, sizeof(used_s), (double)(total - avail) * 1024.0);
+    fmt_bytes(total_s, sizeof(total_s), (double)total * 1024.0);
+    snprintf(out, outlen, "mem %s/%s", used_s, total_s);
+}
 
-        if (tag == focused_ws) {
-            int ry = (g_bar_h - (g_font->ascent + g_font->descent)) / 2 - 2;
-            if (ry < 0) ry = 0;
-            XFillRectangle(g_dpy, g_win, g_gc_focus, tx - 2, ry, w + 4,
-                          g_font->ascent + g_font->descent + 4);
-            XftDrawStringUtf8(g_draw, &g_xft_focus_text, g_font,
-                             tx + TAG_PADDING / 2, text_y,
-                             (FcChar8*)tb, strlen(tb));
-        } else {
-            XftDrawStringUtf8(g_draw, &g_xft_fg, g_font,
-                             tx + TAG_PADDING / 2, text_y,
-                             (FcChar8*)tb, strlen(tb));
+static int mod_battery_open(Module *m) {
+    char path[PATH_MAX];
+    if (!m->arg[0]) {
+        /* pick the first supply that reports type Battery */
+        DIR *d = opendir("/sys/class/power_supply");
+        if (!d) return 0;
+        struct dirent *de;
+        while ((de = readdir(d))) {
+            if (de->d_name[0] == '.') continue;
+            char type[32] = "";
+            snprintf(path, sizeof(path), "/sys/class/power_supply/%s/type", de->d_name);
+            int fd = open_ro(path);
+            if (fd < 0) continue;
+            pread_text(fd, type, sizeof(type));
+            close(fd);
+            size_t nl = strlen(de->d_name);
+            if (strncmp(type, "Battery", 7) == 0 && nl < sizeof(m->arg)) {
+                memcpy(m->arg, de->d_name, nl + 1);
+                break;
+            }
         }
+        closedir(d);
+        if (!m->arg[0]) return 0;
     }
+    snprintf(path, sizeof(path), "/sys/class/power_supply/%s/capacity", m->arg);
+    m->fd[0] = open_ro(path);
+    snprintf(path, sizeof(path), "/sys/class/power_supply/%s/status", m->arg);
+    m->fd[1] = open_ro(path);
+    return m->fd[0] >= 0;
+}
 
-    /* compute positions:
-       left end     = left_width
-       right start  = content_w - PADDING - right_w
-       status area  = between left_end + PADDING  and  right_start - PADDING
-    */
-    int base_left_end = left_width;
-    int right_start = content_w - PADDING - right_w;
-    if (right_start < base_left_end + PADDING) {
-        right_start = base_left_end + PADDING;
+static void mod_battery_update(Module *m, char *out, size_t outlen) {
+    char cap[16], st[32] = "";
+    if (pread_text(m->fd[0], cap, sizeof(cap)) <= 0) { out[0] = '\0'; return; }
+    pread_text(m->fd[1], st, sizeof(st));
+    const char *mark = "";
+    if (strncmp(st, "Charging", 8) == 0) mark = "+";
+    else if (strncmp(st, "Discharging", 11) == 0) mark = "-";
+    snprintf(out, outlen, "bat %d%%%s", atoi(cap), mark);
+}
+
+static int mod_net_open(Module *m) {
+    m->fd[0] = open_ro("/proc/net/dev");
+    m->prev_ts.tv_sec = 0;
+    return m->fd[0] >= 0;
+}
+
+/* sum rx/tx bytes of arg (or every interface except lo) */
+static int net_counters(Module *m, unsigned long long *rx, unsigned long long *tx) {
+    char buf[8192];
+    if (pread_text(m->fd[0], buf, sizeof(buf)) <= 0) return 0;
+    *rx = *tx = 0;
+    int found = 0;
+    char *line = strchr(buf, '\n');
+    if (line) line = strchr(line + 1, '\n'); /* skip the two header lines */
+    while (line && *++line) {
+        char *colon = strchr(line, ':');
+        char *eol = strchr(line, '\n');
+        if (!colon || (eol && colon > eol)) break;
+        char *name = line;
+        while (*name == ' ') ++name;
+        size_t nl = (size_t)(colon - name);
+        int want = m->arg[0] ? (strlen(m->arg) == nl && strncmp(name, m->arg, nl) == 0)
+                             : !(nl == 2 && strncmp(name, "lo", 2) == 0);
+        if (want) {
+            unsigned long long v[9];
+            if (sscanf(colon + 1, "%llu %llu %llu %llu %llu %llu %llu %llu %llu",
+                       &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8]) == 9) {
+                *rx += v[0];
+                *tx += v[8];
+                found = 1;
+            }
+        }
+        line = eol;
     }
+    return found;
+}
 
-    int status_area_left = base_left_end + PADDING;
-    int status_area_right = right_start - PADDING;
-    if (g_fullscreen) {
-        status_area_left = 0;
-        status_area_right = content_w;
+static void mod_net_update(Module *m, char *out, size_t outlen) {
+    unsigned long long rx, tx;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!net_counters(m, &rx, &tx)) { out[0] = '\0'; return; }
+    double dt = (double)(now.tv_sec - m->prev_ts.tv_sec) +
+                (double)(now.tv_nsec - m->prev_ts.tv_nsec) / 1e9;
+    int have_prev = m->prev_ts.tv_sec != 0 && dt > 0;
+    char rs[16] = "0B", ts[16] = "0B";
+    if (have_prev) {
+        fmt_bytes(rs, sizeof(rs), (double)(rx - m->prev[0]) / dt);
+        fmt_bytes(ts, sizeof(ts), (double)(tx - m->prev[1]) / dt);
     }
+    m->prev[0] = rx;
+    m->prev[1] = tx;
+    m->prev_ts = now;
+    snprintf(out, outlen, "rx %s/s tx %s/s", rs, ts);
+}
 
-    int inner_w = status_area_right - status_area_left;
-    int status_x = status_area_left;
-    if (inner_w > 0) {
-        if (status_w < inner_w) {
-            status_x = status_area_left + (inner_w - status_w) / 2;
-        } else {
-            status_x = status_area_left;
+static const ModuleDef g_module_defs[] = {
+    { "clock",   1,  mod_clock_open,   mod_clock_update   },
+    { "uptime",  60, mod_uptime_open,  mod_uptime_update  },
+    { "load",    5,  mod_load_open,    mod_load_update    },
+    { "mem",     5,  mod_mem_open,     mod_mem_update     },
+    { "battery", 30, mod_battery_open, mod_battery_update },
+    { "net",     2,  mod_net_open,     mod_net_update     },
+};
+
+/* instantiate "@name[:arg]"; interval <= 0 keeps the module's own rate.
+   returns NULL if spec is not a module or the module is unavailable here */
+static Module *module_new(const char *spec, int interval) {
+    if (!spec || spec[0] != '@') return NULL;
+    const char *name = spec + 1;
+    const char *colon = strchr(name, ':');
+    size_t nl = colon ? (size_t)(colon - name) : strlen(name);
+    for (size_t i = 0; i < sizeof(g_module_defs) / sizeof(g_module_defs[0]); ++i) {
+        const ModuleDef *def = &g_module_defs[i];
+        if (strlen(def->name) != nl || strncmp(def->name, name, nl) != 0) continue;
+        Module *m = NULL;
+        for (int j = 0; j < g_modules_n && !m; ++j)
+            if (!g_modules[j].def) m = &g_modules[j]; /* slot freed by a config reload */
+        if (!m && g_modules_n >= (int)(sizeof(g_modules) / sizeof(g_modules[0]))) return NULL;
+        int fresh = !m;
+        if (!m) m = &g_modules[g_modules_n];
+        memset(m, 0, sizeof(*m));
+        m->def = def;
+        m->fd[0] = m->fd[1] = -1;
+        if (colon) snprintf(m->arg, sizeof(m->arg), "%s", colon + 1);
+        m->interval = interval;
+        if (!def->open(m)) {
+            if (m->fd[0] >= 0) close(m->fd[0]);
+            if (m->fd[1] >= 0) close(m->fd[1]);
+            m->fd[0] = m->fd[1] = -1;
+            m->def = NULL;
+            return NULL;
         }
-    } else {
-        status_x = status_area_left;
+        if (m->interval <= 0) m->interval = def->interval;
+        if (fresh) g_modules_n++;
+        return m;
     }
+    fprintf(stderr, "unknown module: %s\n", spec);
+    return NULL;
+}
+
+/* refresh m into out; returns 1 when the text changed */
+static int module_update(Module *m, char *out, size_t outlen) {
+    char tmp[MAX_TEXT];
+    m->def->update(m, tmp, sizeof(tmp) < outlen ? sizeof(tmp) : outlen);
+    if (strcmp(tmp, out) == 0) return 0;
+    memcpy(out, tmp, strlen(tmp) + 1);
+    return 1;
+}
 
-    if (status_x < 0) status_x = 0;
-    if (status_x + status_w > content_w) {
-        if (status_w >= content_w) status_x = 0;
-        else status_x = content_w - status_w;
+/* next refresh (monotonic ms), aligned to a wall clock multiple of the interval
+   so a minute clock flips on the minute */
+static uint64_t module_next_due(const Module *m) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t wall = (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+    uint64_t iv = (uint64_t)m->interval * 1000;
+    return now_ms() + (iv - wall % iv) + 1;
+}
+
+/* close m's fds and give its slot back */
+static void module_free(Module *m) {
+    if (m->fd[0] >= 0) close(m->fd[0]);
+    if (m->fd[1] >= 0) close(m->fd[1]);
+    m->fd[0] = m->fd[1] = -1;
+    m->def = NULL;
+}
+
+static void modules_close(void) {
+    for (int i = 0; i < g_modules_n; ++i) {
+        if (g_modules[i].fd[0] >= 0) close(g_modules[i].fd[0]);
+        if (g_modules[i].fd[1] >= 0) close(g_modules[i].fd[1]);
     }
+    g_modules_n = 0;
+}
+
+/* ---------------- wm state files ---------------- */
 
-    if (status_text[0]) {
-        XftDrawStringUtf8(g_draw, &g_xft_shadow, g_font,
-                         status_x + 1, text_y + 1,
-                         (FcChar8*)status_text, strlen(status_text));
-        XftDrawStringUtf8(g_draw, &g_xft_fg, g_font,
-                         status_x, text_y,
-                         (FcChar8*)status_text, strlen(status_text));
+/* (re)read one state file into the cached focused index / occupied bitmap */
+static void wm_file_read(int which, int reopen) {
+    WmFile *wf = &g_wm_files[which];
+    if (reopen || wf->fd < 0) {
+        if (wf->fd >= 0) close(wf->fd);
+        char path[PATH_MAX + 32];
+        snprintf(path, sizeof(path), "%s/%s", g_wm_dir, wf->name);
+        wf->fd = g_wm_dir[0] ? open(path, O_RDONLY | O_CLOEXEC) : -1;
     }
 
-    if (right_text[0]) {
-        int right_draw_x = right_start;
-        if (right_draw_x < 0) right_draw_x = 0;
-        XftDrawStringUtf8(g_draw, &g_xft_shadow, g_font,
-                         right_draw_x + 1, text_y + 1,
-                         (FcChar8*)right_text, strlen(right_text));
-        XftDrawStringUtf8(g_draw, &g_xft_fg, g_font,
-                         right_draw_x, text_y,
-                         (FcChar8*)right_text, strlen(right_text));
+    char buf[256] = "";
+    ssize_t n = wf->fd >= 0 ? pread_text(wf->fd, buf, sizeof(buf)) : -1;
+    if (which == WM_FOCUSED) {
+        g_wm_focused = n > 0 ? atoi(buf) : 0;
+        switch_settle();
+        return;
     }
 
-    XFlush(g_dpy);
+    g_wm_occupied_valid = wf->fd >= 0;
+    g_wm_occupied = 0;
+    char *p = buf;
+    while (*p) {
+        while (*p && !isdigit((unsigned char)*p)) ++p;
+        if (!*p) break;
+        char *end = NULL;
+        long v = strtol(p, &end, 10);
+        if (end == p) break;
+        if (v >= 1 && v <= MAX_WS) g_wm_occupied |= 1u << v;
+        p = end;
+    }
 }
 
-/* ---------------- main ---------------- */
-int main(void) {
-    const char *fontname = HARD_FONT;
-    const char *bg_spec  = HARD_BG;
-    const char *fg_spec  = HARD_FG;
-    const char *focus_spec = HARD_FOCUS_BG;
-    g_cmd = HARD_CMD;
-    g_switch_fmt = NULL;
-    g_ws_count = HARD_WS_COUNT;
-    if (g_ws_count <= 0) g_ws_count = 1;
-    if (g_ws_count > MAX_WS) g_ws_count = MAX_WS;
+/* watch ~/.wm itself so atomic rename-over updates are seen (and IN_MODIFY for
+   a wm that rewrites in place without closing); if it does not exist yet, watch
+   $HOME for it to appear */
+static void wm_watch_dir(void) {
+    if (g_ino_fd < 0 || !g_wm_dir[0]) return;
+    g_wm_wd = inotify_add_watch(g_ino_fd, g_wm_dir,
+                                IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE |
+                                IN_MOVED_FROM | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+    if (g_wm_wd < 0 && g_home_wd < 0 && g_home_path[0])
+        g_home_wd = inotify_add_watch(g_ino_fd, g_home_path, IN_CREATE | IN_MOVED_TO | IN_ONLYDIR);
+}
+
+static void wm_watch_init(void) {
+    g_ino_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wm_watch_dir();
+    for (int i = 0; i < WM_FILE_COUNT; ++i) wm_file_read(i, 1);
+}
+
+static void wm_watch_close(void) {
+    for (int i = 0; i < WM_FILE_COUNT; ++i)
+        if (g_wm_files[i].fd >= 0) close(g_wm_files[i].fd);
+    if (g_ino_fd >= 0) close(g_ino_fd);
+    g_ino_fd = -1;
+}
 
-    g_fullscreen = HARD_FULLSCREEN;
+/* drain every queued event, then re-read only the files that were touched.
+   a burst of writes collapses into one read per file; returns 1 if state changed */
+static int wm_inotify_handle(void) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int touched[WM_FILE_COUNT] = {0}; /* 1 = contents changed, 2 = file replaced */
+    int rescan = 0, reload = 0, cfg_rescan = 0;
 
-    /* populate right cmds from RIGHT_CMDS array */
-    g_right_cmds_n = 0;
-    for (int i = 0; i < RIGHT_CMD_COUNT && g_right_cmds_n < MAX_RIGHT_CMDS; ++i) {
-        if (RIGHT_CMDS[i] && RIGHT_CMDS[i][0]) {
-            g_right_cmds[g_right_cmds_n++] = strdup(RIGHT_CMDS[i]);
+    for (;;) {
+        ssize_t len = read(g_ino_fd, buf, sizeof(buf));
+        if (len < 0 && errno == EINTR) continue;
+        if (len <= 0) break;
+        for (char *p = buf; p < buf + len; ) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            p += sizeof(*ev) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) { rescan = 1; continue; }
+            /* $HOME and the config parent can be the same directory */
+            if (ev->wd == g_home_wd || ev->wd == g_cfg_parent_wd) {
+                if (ev->wd == g_home_wd && ev->len && strcmp(ev->name, ".wm") == 0) rescan = 1;
+                if (ev->wd == g_cfg_parent_wd && ev->len && strcmp(ev->name, "hsdbar") == 0) cfg_rescan = 1;
+                continue;
+            }
+            if (ev->wd == g_cfg_wd) {
+                if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                    g_cfg_wd = -1;
+                    cfg_rescan = 1;
+                } else if (ev->len && strcmp(ev->name, "config") == 0) {
+                    reload = 1;
+                }
+                continue;
+            }
+            if (ev->wd != g_wm_wd) continue;
+            if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                g_wm_wd = -1;
+                rescan = 1;
+                continue;
+            }
+            if (!ev->len) continue;
+            for (int i = 0; i < WM_FILE_COUNT; ++i) {
+                if (strcmp(ev->name, g_wm_files[i].name) != 0) continue;
+                int replaced = (ev->mask & (IN_CREATE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM)) != 0;
+                touched[i] = MAX(touched[i], replaced ? 2 : 1);
+            }
         }
     }
 
-    const char *home = getenv("HOME");
-    if (home) {
-        snprintf(g_focused_path, sizeof(g_focused_path), "%s/.wm/focused.workspace", home);
-        snprintf(g_occupied_path, sizeof(g_occupied_path), "%s/.wm/occupied.workspace", home);
-    } else {
-        g_focused_path[0] = g_occupied_path[0] = 0;
+    if (rescan) {
+        if (g_wm_wd < 0) wm_watch_dir();
+        for (int i = 0; i < WM_FILE_COUNT; ++i) touched[i] = 2;
     }
 
-    int inofd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
-    int watch_focused = -1, watch_occupied = -1;
-    if (inofd >= 0) {
-        if (g_focused_path[0])
-            watch_focused = inotify_add_watch(inofd, g_focused_path,
-                                            IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM);
-        if (g_occupied_path[0])
-            watch_occupied = inotify_add_watch(inofd, g_occupied_path,
-                                             IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM);
+    if (cfg_rescan) {
+        if (g_cfg_wd < 0) config_watch();
+        reload = 1; /* the directory may have come with a config in it */
     }
+    if (reload) config_reload(); /* an editor's save burst is one reload */
 
-    g_dpy = XOpenDisplay(NULL);
-    if (!g_dpy) { fprintf(stderr, "cannot open display\n"); return 1; }
-    g_scr = DefaultScreen(g_dpy);
-    g_root = RootWindow(g_dpy, g_scr);
-    g_cmap = DefaultColormap(g_dpy, g_scr);
-    g_screen_w = DisplayWidth(g_dpy, g_scr);
-    g_bar_h = HARD_BAR_HEIGHT;
-    if (g_bar_h <= 0) g_bar_h = 28;
+    int before_f = g_wm_focused, before_v = g_wm_occupied_valid;
+    unsigned int before_o = g_wm_occupied;
+    for (int i = 0; i < WM_FILE_COUNT; ++i)
+        if (touched[i]) wm_file_read(i, touched[i] == 2);
+    return before_f != g_wm_focused || before_o != g_wm_occupied || before_v != g_wm_occupied_valid;
+}
+
+/* ---------------- ipc ---------------- */
+
+/* $XDG_RUNTIME_DIR/hsdbar.sock, or the abstract name hsdbar.<uid> without a runtime dir */
+static void ipc_addr_init(void) {
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    memset(&g_ipc_addr, 0, sizeof(g_ipc_addr));
+    g_ipc_addr.sun_family = AF_UNIX;
+    int n;
+    if (dir && dir[0]) {
+        n = snprintf(g_ipc_addr.sun_path, sizeof(g_ipc_addr.sun_path), "%s/hsdbar.sock", dir);
+        g_ipc_addr_len = offsetof(struct sockaddr_un, sun_path) + n + 1;
+    } else {
+        n = snprintf(g_ipc_addr.sun_path + 1, sizeof(g_ipc_addr.sun_path) - 1, "hsdbar.%u", (unsigned)getuid());
+        g_ipc_addr_len = offsetof(struct sockaddr_un, sun_path) + 1 + n;
+    }
+    if (n < 0 || n >= (int)sizeof(g_ipc_addr.sun_path) - 1) g_ipc_addr_len = 0;
+}
+
+static IpcSeg *ipc_seg_find(const char *name, int create) {
+    IpcSeg *free_slot = NULL;
+    for (int i = 0; i < MAX_IPC_SEGS; ++i) {
+        if (!g_ipc_segs[i].name[0]) { if (!free_slot) free_slot = &g_ipc_segs[i]; }
+        else if (strcmp(g_ipc_segs[i].name, name) == 0) return &g_ipc_segs[i];
+    }
+    if (!create || !free_slot || strlen(name) >= sizeof(free_slot->name)) return NULL;
+    strcpy(free_slot->name, name);
+    free_slot->text[0] = '\0';
+    return free_slot;
+}
+
+/* one protocol line:
+     focus N            focused workspace (1-based)
+     occupied MASK      occupied bitmap, bit 0 = workspace 1 (decimal or 0x..)
+     seg NAME [TEXT]    set a named segment, no text removes it
+     redraw             repaint everything
+     shm                reply with the shared segment table and its doorbell (SCM_RIGHTS)
+     stats              reply with the stats JSON
+   returns 2 for focus/occupied changes, 1 for other visible changes, 0 otherwise */
+static void shm_send(int fd);
+static void stats_json(FILE *f);
+
+static int ipc_line(IpcClient *c, char *line) {
+    char *arg = line + strcspn(line, " ");
+    if (*arg) *arg++ = '\0';
+    if (strcmp(line, "focus") == 0) {
+        int ws = atoi(arg);
+        if (ws < 1 || ws > MAX_WS || ws == g_wm_focused) return 0;
+        g_wm_focused = ws;
+        switch_settle();
+        return 2;
+    }
+    if (strcmp(line, "occupied") == 0) {
+        unsigned int occ = (unsigned int)(strtoul(arg, NULL, 0) << 1) & ((2u << MAX_WS) - 2);
+        if (g_wm_occupied_valid && occ == g_wm_occupied) return 0;
+        g_wm_occupied = occ;
+        g_wm_occupied_valid = 1;
+        return 2;
+    }
+    if (strcmp(line, "seg") == 0) {
+        char *text = arg + strcspn(arg, " ");
+        if (*text) *text++ = '\0';
+        if (!arg[0]) return 0;
+        IpcSeg *seg = ipc_seg_find(arg, text[0] != '\0');
+        if (!seg) return 0;
+        if (!text[0]) {
+            seg->name[0] = '\0';
+            return 1;
+        }
+        if (strcmp(seg->text, text) == 0) return 0;
+        snprintf(seg->text, sizeof(seg->text), "%s", text);
+        return 1;
+    }
+    if (strcmp(line, "redraw") == 0) {
+        for (int i = 0; i < g_bars_n; ++i) g_bars[i].frame_valid = 0;
+        return 1;
+    }
+    if (strcmp(line, "shm") == 0) shm_send(c->fd);
+    if (strcmp(line, "stats") == 0) {
+        char *buf = NULL;
+        size_t len = 0;
+        FILE *m = open_memstream(&buf, &len);
+        if (m) {
+            stats_json(m);
+            fclose(m);
+            if (send(c->fd, buf, len, MSG_NOSIGNAL) < 0) { /* client went away */ }
+            free(buf);
+        }
+    }
+    return 0;
+}
+
+static void ipc_client_close(IpcClient *c) {
+    io_del(c->watch);
+    c->watch = NULL;
+    close(c->fd);
+    c->fd = -1;
+}
+
+/* drain a client and run every complete line; workspace changes render right
+   away like clicks, text changes go through the frame cap */
+static void ipc_client_io(void *ctx, unsigned int events) {
+    (void)events;
+    IpcClient *c = ctx;
+    int changed = 0;
+    for (;;) {
+        ssize_t r = read(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+            if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) ipc_client_close(c);
+            break;
+        }
+        c->len += (size_t)r;
+        char *start = c->buf, *nl;
+        while ((nl = memchr(start, '\n', c->len - (size_t)(start - c->buf)))) {
+            *nl = '\0';
+            if (!c->overlong) {
+                int v = ipc_line(c, start);
+                if (v > changed) changed = v;
+            }
+            c->overlong = 0;
+            start = nl + 1;
+        }
+        c->len -= (size_t)(start - c->buf);
+        memmove(c->buf, start, c->len);
+        if (c->len == sizeof(c->buf) - 1) {
+            c->overlong = 1;
+            c->len = 0;
+        }
+    }
+    if (changed == 2) render_frame(TRIG_IPC);
+    else if (changed) request_frame(TRIG_IPC);
+}
+
+static void ipc_accept_io(void *ctx, unsigned int events) {
+    (void)ctx; (void)events;
+    int fd;
+    while ((fd = accept4(g_ipc_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        /* the abstract fallback socket has no file permissions: only our own uid
+           may talk to the bar (and be handed the shm table) */
+        struct ucred cred;
+        socklen_t clen = sizeof(cred);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &clen) < 0 || cred.uid != getuid()) {
+            close(fd);
+            continue;
+        }
+        IpcClient *c = NULL;
+        for (int i = 0; i < MAX_IPC_CLIENTS && !c; ++i)
+            if (g_ipc_clients[i].fd < 0) c = &g_ipc_clients[i];
+        if (!c) { close(fd); continue; }
+        c->fd = fd;
+        c->len = 0;
+        c->overlong = 0;
+        c->watch = io_add(fd, ipc_client_io, c);
+        if (!c->watch) { close(fd); c->fd = -1; }
+    }
+}
+
+/* listen on the socket; a live bar already owning it keeps it */
+static void ipc_init(void) {
+    for (int i = 0; i < MAX_IPC_CLIENTS; ++i) g_ipc_clients[i].fd = -1;
+    ipc_addr_init();
+    if (!g_ipc_addr_len) return;
+    g_ipc_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (g_ipc_fd < 0) return;
+    if (g_ipc_addr.sun_path[0]) {
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (probe >= 0 && connect(probe, (struct sockaddr*)&g_ipc_addr, g_ipc_addr_len) == 0) {
+            fprintf(stderr, "ipc: %s is in use\n", g_ipc_addr.sun_path);
+            close(probe);
+            close(g_ipc_fd);
+            g_ipc_fd = -1;
+            return;
+        }
+        if (probe >= 0) close(probe);
+        unlink(g_ipc_addr.sun_path); /* stale socket of a dead bar */
+    }
+    if (bind(g_ipc_fd, (struct sockaddr*)&g_ipc_addr, g_ipc_addr_len) < 0 ||
+        listen(g_ipc_fd, MAX_IPC_CLIENTS) < 0) {
+        close(g_ipc_fd);
+        g_ipc_fd = -1;
+        return;
+    }
+    io_add(g_ipc_fd, ipc_accept_io, NULL);
+}
+
+static void ipc_close(void) {
+    for (int i = 0; i < MAX_IPC_CLIENTS; ++i)
+        if (g_ipc_clients[i].fd >= 0) close(g_ipc_clients[i].fd);
+    if (g_ipc_fd < 0) return;
+    close(g_ipc_fd);
+    if (g_ipc_addr.sun_path[0]) unlink(g_ipc_addr.sun_path);
+}
+
+/* ---------------- shared memory segments ---------------- */
+
+static void shm_doorbell_io(void *ctx, unsigned int events) {
+    (void)ctx; (void)events;
+    uint64_t n;
+    while (read(g_shm_efd, &n, sizeof(n)) > 0) {}
+    request_frame(TRIG_SHM); /* segments are read when the frame is built */
+}
+
+static void shm_init(void) {
+    g_shm_fd = hsdbar_shm_create(&g_shm);
+    if (g_shm_fd < 0) return;
+    g_shm_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_shm_efd < 0) return;
+    atomic_store(&g_shm->armed, 1);
+    io_add(g_shm_efd, shm_doorbell_io, NULL);
+}
+
+static void shm_close(void) {
+    if (g_shm) munmap(g_shm, sizeof(*g_shm));
+    if (g_shm_fd >= 0) close(g_shm_fd);
+    if (g_shm_efd >= 0) close(g_shm_efd);
+}
+
+/* hand the table and doorbell to an ipc client */
+static void shm_send(int fd) {
+    if (g_shm_fd < 0 || g_shm_efd < 0) return;
+    int fds[2] = { g_shm_fd, g_shm_efd };
+    char byte = 0;
+    char ctrl[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = { &byte, 1 };
+    struct msghdr msg = { 0 };
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+    sendmsg(fd, &msg, MSG_NOSIGNAL);
+}
+
+/* called while building a frame: re-arm the doorbell first so no write is missed,
+   then copy only the segments whose sequence moved */
+static void shm_poll(void) {
+    if (!g_shm) return;
+    atomic_store(&g_shm->armed, 1);
+    for (int i = 0; i < HSDBAR_SHM_SEGS; ++i)
+        hsdbar_shm_read(g_shm, i, g_shm_text[i], &g_shm_seen[i]);
+}
+
+/* --send LINE...: client side, one protocol line per argument */
+static int ipc_send(int argc, char **argv) {
+    ipc_addr_init();
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("ipc");
+        return 1;
+    }
+    if (!g_ipc_addr_len || connect(fd, (struct sockaddr*)&g_ipc_addr, g_ipc_addr_len) < 0) {
+        perror("ipc");
+        close(fd);
+        return 1;
+    }
+    char buf[MAX_TEXT * 2];
+    size_t len = 0;
+    for (int i = 0; i < argc; ++i) {
+        int n = snprintf(buf + len, sizeof(buf) - len, "%s\n", argv[i]);
+        if (n < 0 || (size_t)n >= sizeof(buf) - len) break;
+        len += (size_t)n;
+    }
+    int ok = write(fd, buf, len) == (ssize_t)len;
+    /* replies (stats) come back until the bar sees our EOF */
+    shutdown(fd, SHUT_WR);
+    ssize_t r;
+    while ((r = read(fd, buf, sizeof(buf))) > 0)
+        if (fwrite(buf, 1, (size_t)r, stdout) != (size_t)r) break;
+    close(fd);
+    return ok ? 0 : 1;
+}
+
+/* ---------------- right command scheduler ---------------- */
+
+static void right_cmd_io(void *ctx, unsigned int events);
+
+/* start rc in the background; its stdout is collected via rc->fd */
+static int right_cmd_start(RightCmd *rc) {
+    if (!rc->cmd || !rc->cmd[0] || rc->pid > 0) return 0;
+    int p[2];
+    if (pipe2(p, O_CLOEXEC) < 0) return 0;
+
+    pid_t pid = spawn_cmd(rc->cmd, p[1], -1, 0);
+    close(p[1]);
+    if (pid < 0) {
+        close(p[0]);
+        return 0;
+    }
+
+    int flags = fcntl(p[0], F_GETFL, 0);
+    if (flags >= 0) fcntl(p[0], F_SETFL, flags | O_NONBLOCK);
+    rc->pid = pid;
+    rc->fd = p[0];
+    rc->len = 0;
+    rc->watch = io_add(rc->fd, right_cmd_io, rc);
+    return 1;
+}
+
+/* drain rc->fd; on EOF publish the first line into rc->out and schedule the next run */
+static void right_cmd_io(void *ctx, unsigned int events) {
+    (void)events;
+    RightCmd *rc = ctx;
+    if (rc->fd < 0) return;
+    for (;;) {
+        char tmp[1024];
+        ssize_t r = read(rc->fd, tmp, sizeof(tmp));
+        if (r > 0) {
+            size_t room = sizeof(rc->buf) - 1 - rc->len;
+            if ((size_t)r > room) r = (ssize_t)room;
+            memcpy(rc->buf + rc->len, tmp, (size_t)r);
+            rc->len += (size_t)r;
+            continue;
+        }
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        break; /* EOF or hard error: the run is over */
+    }
+
+    io_del(rc->watch);
+    rc->watch = NULL;
+    close(rc->fd);
+    rc->fd = -1;
+    if (rc->interval > 0) timer_arm(&rc->timer, now_ms() + (uint64_t)rc->interval * 1000);
+
+    rc->buf[rc->len] = '\0';
+    char *nl = strchr(rc->buf, '\n');
+    if (nl) *nl = '\0';
+    if (strcmp(rc->out, rc->buf) == 0) return;
+    memcpy(rc->out, rc->buf, strlen(rc->buf) + 1);
+    request_frame(TRIG_PIPE);
+}
+
+/* rc's deadline: refresh a module in-process, or start the command */
+static void right_cmd_due(void *ctx) {
+    RightCmd *rc = ctx;
+    uint64_t retry = now_ms() + (uint64_t)(rc->interval > 0 ? rc->interval : 1) * 1000;
+    if (rc->mod) {
+        int changed = module_update(rc->mod, rc->out, sizeof(rc->out));
+        timer_arm(&rc->timer, module_next_due(rc->mod));
+        if (changed) request_frame(TRIG_TIMER);
+        return;
+    }
+    if (rc->fd >= 0 || rc->pid > 0) {
+        /* previous run still going: try again next interval */
+        timer_arm(&rc->timer, retry);
+        return;
+    }
+    if (!right_cmd_start(rc)) timer_arm(&rc->timer, retry);
+}
+
+static int status_cmd_try_reap(void);
+
+/* SIGCHLD: reap the children we know about and forget their pids.
+   the status command has its own path (pidfd) and is only checked here as a fallback */
+static void reap_children(void) {
+    int st;
+    for (int i = 0; i < g_right_cmds_n; ++i) {
+        RightCmd *rc = &g_right_cmds[i];
+        if (rc->pid > 0 && waitpid(rc->pid, &st, WNOHANG) != 0) rc->pid = -1;
+    }
+    bg_reap();
+    status_cmd_try_reap();
+}
+
+/* ---------------- EWMH state ---------------- */
+
+/* ignore errors from client windows vanishing under us, die on anything else */
+static int xerror(Display *dpy, XErrorEvent *ee) {
+    if (ee->error_code == BadWindow ||
+        (ee->request_code == X_GetProperty && ee->error_code == BadValue) ||
+        (ee->request_code == X_ChangeWindowAttributes && ee->error_code == BadAccess))
+        return 0;
+    char msg[128];
+    XGetErrorText(dpy, ee->error_code, msg, sizeof(msg));
+    fprintf(stderr, "X error: request %d: %s\n", ee->request_code, msg);
+    exit(1);
+}
+
+/* one round trip for the whole table */
+static void atoms_init(void) {
+    XInternAtoms(g_dpy, g_atom_names, AtomLast, False, g_atoms);
+}
+
+/* ---------------- X requests ---------------- */
+
+/* the requests that wait for a reply go through here. the Xlib backend asks and
+   waits one at a time; the XCB backend (make BACKEND=xcb) sends a whole batch on
+   the same connection and then collects the replies, so a batch costs one round
+   trip. drawing and events stay on Xlib/Xft with either backend */
+
+#ifdef XCB
+static void props_get(PropReq *r, int n) {
+    xcb_connection_t *c = XGetXCBConnection(g_dpy);
+    for (int base = 0; base < n; base += XREQ_BATCH) {
+        xcb_get_property_cookie_t ck[XREQ_BATCH];
+        int m = MIN(XREQ_BATCH, n - base);
+        for (int i = 0; i < m; ++i) {
+            PropReq *p = &r[base + i];
+            p->vals = NULL;
+            p->n = 0;
+            if (p->prop)
+                ck[i] = xcb_get_property(c, 0, (xcb_window_t)p->win, (xcb_atom_t)p->prop,
+                                         XCB_GET_PROPERTY_TYPE_ANY, 0, (uint32_t)p->max);
+        }
+        ROUNDTRIP();
+        for (int i = 0; i < m; ++i) {
+            PropReq *p = &r[base + i];
+            if (!p->prop) continue;
+            xcb_generic_error_t *err = NULL;
+            xcb_get_property_reply_t *rep = xcb_get_property_reply(c, ck[i], &err);
+            free(err); /* BadWindow: the client is gone, same as a missing property */
+            int len = rep && rep->format == 32 ? xcb_get_property_value_length(rep) / 4 : 0;
+            if (len > 0 && (p->vals = malloc(sizeof(long) * (size_t)len))) {
+                const uint32_t *v = xcb_get_property_value(rep);
+                for (int j = 0; j < len; ++j) p->vals[j] = (long)(int32_t)v[j]; /* as Xlib does */
+                p->n = (unsigned long)len;
+            }
+            free(rep);
+        }
+    }
+}
+
+static void props_free(PropReq *r, int n) {
+    for (int i = 0; i < n; ++i) {
+        free(r[i].vals);
+        r[i].vals = NULL;
+    }
+}
+#else
+static void props_get(PropReq *r, int n) {
+    for (int i = 0; i < n; ++i) {
+        PropReq *p = &r[i];
+        Atom type; int format; unsigned long after;
+        unsigned char *data = NULL;
+        p->vals = NULL;
+        p->n = 0;
+        if (!p->prop) continue;
+        ROUNDTRIP();
+        if (XGetWindowProperty(g_dpy, p->win, p->prop, 0, p->max, False, AnyPropertyType,
+                               &type, &format, &p->n, &after, &data) != Success || !data) {
+            p->n = 0;
+            continue;
+        }
+        if (format != 32) { XFree(data); p->n = 0; continue; }
+        p->vals = (long *)data;
+    }
+}
+
+static void props_free(PropReq *r, int n) {
+    for (int i = 0; i < n; ++i) {
+        if (r[i].vals) XFree(r[i].vals);
+        r[i].vals = NULL;
+    }
+}
+#endif
+
+static long get_card(Window w, Atom a, long def) {
+    PropReq r = { w, a, 1, NULL, 0 };
+    props_get(&r, 1);
+    long v = r.n ? r.vals[0] : def;
+    props_free(&r, 1);
+    return v;
+}
+
+/* workspace (1-based) a _NET_WM_DESKTOP value maps to, 0 for sticky/out of range */
+static int desk_to_ws(long d) {
+    if (d < 0 || d >= MAX_WS) return 0;
+    return (int)d + 1;
+}
+
+static void ewmh_set_current(long d) {
+    g_ewmh_current = desk_to_ws(d) ? desk_to_ws(d) : -1;
+    switch_settle();
+}
+
+static void ewmh_read_current(void) {
+    ewmh_set_current(get_card(g_root, g_atoms[NetCurrentDesktop], -1));
+}
+
+static void ewmh_read_ndesktops(void) {
+    g_ewmh_ndesktops = (int)get_card(g_root, g_atoms[NetNumberOfDesktops], 0);
+}
+
+static int client_cmp(const void *a, const void *b) {
+    Window x = ((const EwmhClient*)a)->win, y = ((const EwmhClient*)b)->win;
+    return x < y ? -1 : x > y;
+}
+
+static EwmhClient *client_find(Window w) {
+    EwmhClient key = { w, 0 };
+    if (!g_clients_n) return NULL;
+    return bsearch(&key, g_clients, g_clients_n, sizeof(EwmhClient), client_cmp);
+}
+
+static void client_set_desk(EwmhClient *c, int ws) {
+    if (c->desk) g_desk_clients[c->desk]--;
+    c->desk = ws;
+    if (c->desk) g_desk_clients[c->desk]++;
+}
+
+/* _NET_WM_DESKTOP of one client changed */
+static void ewmh_client_update(Window w) {
+    EwmhClient *c = client_find(w);
+    if (c) client_set_desk(c, desk_to_ws(get_card(w, g_atoms[NetWMDesktop], -1)));
+}
+
+/* a new _NET_CLIENT_LIST: diff against the cached map, only new clients get read,
+   all of them in one batch */
+static void ewmh_set_clients(const PropReq *list) {
+    EwmhClient *next = list->n ? calloc(list->n, sizeof(EwmhClient)) : NULL;
+    int next_n = 0;
+    for (unsigned long i = 0; next && i < list->n; ++i) {
+        Window w = (Window)list->vals[i];
+        if (bar_find(w)) continue;
+        next[next_n].win = w;
+        next[next_n].desk = -1; /* unknown yet */
+        next_n++;
+    }
+    if (next_n) qsort(next, next_n, sizeof(EwmhClient), client_cmp);
+
+    /* carry over known clients, forget the ones that left */
+    memset(g_desk_clients, 0, sizeof(g_desk_clients));
+    for (int i = 0; i < next_n; ++i) {
+        EwmhClient *old = client_find(next[i].win);
+        if (old) next[i].desk = old->desk;
+    }
+    free(g_clients);
+    g_clients = next;
+    g_clients_n = next_n;
+
+    int fresh = 0;
+    for (int i = 0; i < g_clients_n; ++i) {
+        EwmhClient *c = &g_clients[i];
+        if (c->desk < 0) fresh++;
+        else if (c->desk) g_desk_clients[c->desk]++;
+    }
+    PropReq *reqs = fresh ? calloc((size_t)fresh, sizeof(PropReq)) : NULL;
+    int k = 0;
+    for (int i = 0; reqs && i < g_clients_n; ++i) {
+        if (g_clients[i].desk >= 0) continue;
+        XSelectInput(g_dpy, g_clients[i].win, PropertyChangeMask);
+        reqs[k].win = g_clients[i].win;
+        reqs[k].prop = g_atoms[NetWMDesktop];
+        reqs[k].max = 1;
+        k++;
+    }
+    props_get(reqs, k);
+    k = 0;
+    for (int i = 0; i < g_clients_n; ++i) {
+        EwmhClient *c = &g_clients[i];
+        if (c->desk >= 0) continue;
+        c->desk = 0;
+        if (reqs) client_set_desk(c, desk_to_ws(reqs[k].n ? reqs[k].vals[0] : -1));
+        k++;
+    }
+    props_free(reqs, reqs ? fresh : 0);
+    free(reqs);
+}
+
+static void ewmh_sync_clients(void) {
+    PropReq r = { g_root, g_atoms[NetClientList], 4096, NULL, 0 };
+    props_get(&r, 1);
+    ewmh_set_clients(&r);
+    props_free(&r, 1);
+}
+
+/* occupied workspaces according to EWMH (bit i = workspace i) */
+static unsigned int ewmh_occupied(void) {
+    unsigned int bits = 0;
+    for (int i = 1; i <= MAX_WS; ++i) if (g_desk_clients[i] > 0) bits |= 1u << i;
+    return bits;
+}
+
+static void ewmh_init(void) {
+    XSelectInput(g_dpy, g_root, PropertyChangeMask | StructureNotifyMask); /* + root resizes */
+    PropReq r[3] = {
+        { g_root, g_atoms[NetCurrentDesktop], 1, NULL, 0 },
+        { g_root, g_atoms[NetNumberOfDesktops], 1, NULL, 0 },
+        { g_root, g_atoms[NetClientList], 4096, NULL, 0 },
+    };
+    props_get(r, 3);
+    ewmh_set_current(r[0].n ? r[0].vals[0] : -1);
+    g_ewmh_ndesktops = r[1].n ? (int)r[1].vals[0] : 0;
+    ewmh_set_clients(&r[2]);
+    props_free(r, 3);
+}
+
+/* PropertyNotify on the root or a client; returns 1 if workspace state may have changed */
+static int ewmh_property(const XPropertyEvent *pe) {
+    if (pe->window == g_root) {
+        if (pe->atom == g_atoms[NetCurrentDesktop]) ewmh_read_current();
+        else if (pe->atom == g_atoms[NetNumberOfDesktops]) ewmh_read_ndesktops();
+        else if (pe->atom == g_atoms[NetClientList]) ewmh_sync_clients();
+        else return 0;
+        return 1;
+    }
+    if (pe->atom == g_atoms[NetWMDesktop]) {
+        ewmh_client_update(pe->window);
+        return 1;
+    }
+    return 0;
+}
+
+/* scale a 16-bit channel into the bits of mask */
+static unsigned long color_channel(unsigned short v, unsigned long mask) {
+    int shift = 0, bits = 0;
+    if (!mask) return 0;
+    while (!(mask & 1)) { mask >>= 1; shift++; }
+    while (mask & 1) { mask >>= 1; bits++; }
+    return (unsigned long)(v >> (16 - bits)) << shift;
+}
+
+/* XAllocColor without the round trip where the pixel follows from the visual */
+static int color_alloc(Display *dpy, Colormap cmap, XColor *c) {
+    Visual *vis = DefaultVisual(dpy, DefaultScreen(dpy));
+    if (vis->class == TrueColor && cmap == DefaultColormap(dpy, DefaultScreen(dpy))) {
+        c->pixel = color_channel(c->red, vis->red_mask) | color_channel(c->green, vis->green_mask) |
+                   color_channel(c->blue, vis->blue_mask);
+        return 1;
+    }
+    return XAllocColor(dpy, cmap, c);
+}
+
+/* "#rrggbb" parses client side; only color names ask the server */
+static int parse_color(Display *dpy, Colormap cmap, const char *spec, XColor *out) {
+    XColor tmp;
+    if (!spec) return 0;
+    if (!XParseColor(dpy, cmap, spec, &tmp)) return 0;
+    if (!color_alloc(dpy, cmap, &tmp)) return 0;
+    *out = tmp;
+    return 1;
+}
+
+static double lum_from_xcolor(const XColor *xc) {
+    double r = (double)xc->red / 65535.0;
+    double g = (double)xc->green / 65535.0;
+    double b = (double)xc->blue / 65535.0;
+    return 0.2126 * r + 0.7152 * g + 0.0722 * b;
+}
+
+/* convenience: allocate an XftColor from an XColor; returns 1 on success */
+static int alloc_xft_from_xcolor(Display *dpy, Visual *vis, Colormap cmap, const XColor *xc, XftColor *out) {
+    XRenderColor rc;
+    rc.red   = (unsigned short)xc->red;
+    rc.green = (unsigned short)xc->green;
+    rc.blue  = (unsigned short)xc->blue;
+    rc.alpha = 0xffff;
+    if (XftColorAllocValue(dpy, vis, cmap, &rc, out)) return 1;
+
+    /* fallback: try pure black or white based on xc brightness */
+    double lum = lum_from_xcolor(xc);
+    if (lum > 0.5) {
+        XRenderColor rb = { 0, 0, 0, 0xffff };
+        return XftColorAllocValue(dpy, vis, cmap, &rb, out);
+    } else {
+        XRenderColor rw = { 0xffff, 0xffff, 0xffff, 0xffff };
+        return XftColorAllocValue(dpy, vis, cmap, &rw, out);
+    }
+}
 
-    /* parse background first */
-    if (!parse_color(g_dpy, g_cmap, bg_spec, &g_xc_bg)) {
+/* bar background; white if spec does not parse */
+static void color_bg_set(const char *spec) {
+    if (!parse_color(g_dpy, g_cmap, spec, &g_xc_bg)) {
         g_xc_bg.red = g_xc_bg.green = g_xc_bg.blue = 0xffff;
         g_bg_pixel = WhitePixel(g_dpy, g_scr);
     } else {
         g_bg_pixel = g_xc_bg.pixel;
     }
+}
 
-    /* parse foreground; if parsing fails, pick a contrasting fg based on background luminance */
-    if (!parse_color(g_dpy, g_cmap, fg_spec, &g_xc_fg)) {
+/* text color and its shadow; if spec does not parse, pick one that contrasts with
+   the background. replace frees the Xft colors of the previous call */
+static void color_fg_set(const char *spec, int replace) {
+    Visual *vis = DefaultVisual(g_dpy, g_scr);
+    if (replace) {
+        XftColorFree(g_dpy, vis, g_cmap, &g_xft_fg);
+        XftColorFree(g_dpy, vis, g_cmap, &g_xft_shadow);
+    }
+    if (!parse_color(g_dpy, g_cmap, spec, &g_xc_fg)) {
         double lum_bg = lum_from_xcolor(&g_xc_bg);
         if (lum_bg > 0.5) {
             g_xc_fg.red = g_xc_fg.green = g_xc_fg.blue = 0x0000; /* dark text on light bg */
         } else {
             g_xc_fg.red = g_xc_fg.green = g_xc_fg.blue = 0xffff; /* light text on dark bg */
         }
-        XAllocColor(g_dpy, g_cmap, &g_xc_fg);
-    }
-
-    /* parse focus color, fallback to a sane blue-ish if missing */
-    if (!parse_color(g_dpy, g_cmap, focus_spec, &g_xc_focus)) {
-        g_xc_focus.red = 0x1e00;
-        g_xc_focus.green = 0x9000;
-        g_xc_focus.blue = 0xff00;
-        XAllocColor(g_dpy, g_cmap, &g_xc_focus);
-    }
-
-    Visual *vis = DefaultVisual(g_dpy, g_scr);
-
-    g_font = XftFontOpenName(g_dpy, g_scr, fontname);
-    if (!g_font) g_font = XftFontOpenName(g_dpy, g_scr, "xterm-12");
-    if (!g_font) g_font = XftFontOpenName(g_dpy, g_scr, "monospace-12");
-    if (!g_font) {
-        fprintf(stderr, "failed to open Xft font; try installing fonts or set HARD_FONT to a valid Fc name\n");
-        XCloseDisplay(g_dpy);
-        return 1;
+        color_alloc(g_dpy, g_cmap, &g_xc_fg);
     }
 
     /* allocate Xft colors with safer fallbacks */
@@ -622,6 +1934,18 @@ int main(void) {
         XRenderColor rb = { 0, 0, 0, 0xffff };
         XftColorAllocValue(g_dpy, vis, g_cmap, &rb, &g_xft_shadow);
     }
+}
+
+/* focused tag background and the text drawn on it; falls back to a sane blue */
+static void color_focus_set(const char *spec, int replace) {
+    Visual *vis = DefaultVisual(g_dpy, g_scr);
+    if (replace) XftColorFree(g_dpy, vis, g_cmap, &g_xft_focus_text);
+    if (!parse_color(g_dpy, g_cmap, spec, &g_xc_focus)) {
+        g_xc_focus.red = 0x1e00;
+        g_xc_focus.green = 0x9000;
+        g_xc_focus.blue = 0xff00;
+        color_alloc(g_dpy, g_cmap, &g_xc_focus);
+    }
 
     double lum_focus = lum_from_xcolor(&g_xc_focus);
     XRenderColor rc_focus_text;
@@ -631,183 +1955,2289 @@ int main(void) {
         rc_focus_text.red = rc_focus_text.green = rc_focus_text.blue = 0xffff;
     rc_focus_text.alpha = 0xffff;
     XftColorAllocValue(g_dpy, vis, g_cmap, &rc_focus_text, &g_xft_focus_text);
+}
 
-    XSetWindowAttributes wa;
-    wa.override_redirect = False;
-    wa.background_pixel = g_bg_pixel; /* ensure window background matches requested bg */
-    wa.event_mask = ExposureMask | ButtonPressMask | StructureNotifyMask;
-    g_win = XCreateWindow(g_dpy, g_root, 0, 0, 200, g_bar_h, 0, DefaultDepth(g_dpy, g_scr),
-                          CopyFromParent, DefaultVisual(g_dpy, g_scr),
-                          CWBackPixel | CWEventMask, &wa);
+/* the configured font, else the usual suspects; NULL if nothing opens */
+static XftFont *font_open(const char *name) {
+    XftFont *f = XftFontOpenName(g_dpy, g_scr, name);
+    if (!f) f = XftFontOpenName(g_dpy, g_scr, "xterm-12");
+    if (!f) f = XftFontOpenName(g_dpy, g_scr, "monospace-12");
+    return f;
+}
 
-    Atom a_type = XInternAtom(g_dpy, "_NET_WM_WINDOW_TYPE", False);
-    Atom a_type_dock = XInternAtom(g_dpy, "_NET_WM_WINDOW_TYPE_DOCK", False);
-    if (a_type && a_type_dock)
-        XChangeProperty(g_dpy, g_win, a_type, XA_ATOM, 32, PropModeReplace,
-                       (unsigned char *)&a_type_dock, 1);
+/* implementation: set _NET_WM_STRUT and _NET_WM_STRUT_PARTIAL so the dock reserves space;
+   the partial strut only covers columns x0..x1 (the bar's output) */
+static void set_strut(Display *dpy, Window win, int top, int x0, int x1) {
+    Atom a_strut = g_atoms[NetWMStrut];
+    Atom a_strut_partial = g_atoms[NetWMStrutPartial];
+    if (!a_strut || !a_strut_partial) return;
 
-    Atom a_state = XInternAtom(g_dpy, "_NET_WM_STATE", False);
-    Atom a_state_above = XInternAtom(g_dpy, "_NET_WM_STATE_ABOVE", False);
-    Atom a_state_sticky = XInternAtom(g_dpy, "_NET_WM_STATE_STICKY", False);
-    Atom states[2];
-    int nstates = 0;
-    if (a_state_above) states[nstates++] = a_state_above;
-    if (a_state_sticky) states[nstates++] = a_state_sticky;
-    if (nstates && a_state)
-        XChangeProperty(g_dpy, g_win, a_state, XA_ATOM, 32, PropModeReplace,
-                        (unsigned char*)states, nstates);
+    long strut[4] = {0, 0, top, 0};
+    long partial[12] = {0};
+    partial[2] = top;
+    partial[8] = x0;  /* top_start_x */
+    partial[9] = x1;  /* top_end_x */
+    XChangeProperty(dpy, win, a_strut, XA_CARDINAL, 32, PropModeReplace, (unsigned char*)strut, 4);
+    XChangeProperty(dpy, win, a_strut_partial, XA_CARDINAL, 32, PropModeReplace, (unsigned char*)partial, 12);
+}
 
-    Atom a_pid = XInternAtom(g_dpy, "_NET_WM_PID", False);
-    if (a_pid) {
-        unsigned long pid = (unsigned long)getpid();
-        XChangeProperty(g_dpy, g_win, a_pid, XA_CARDINAL, 32, PropModeReplace,
-                        (unsigned char*)&pid, 1);
-    }
+/* the wm answered (or the wait is over): drop the optimistic highlight */
+static void switch_settle(void) {
+    if (!g_switch_pending) return;
+    g_switch_pending = 0;
+    timer_cancel(&g_switch_timer);
+}
 
-    g_gc_bg = XCreateGC(g_dpy, g_win, 0, NULL);
-    XSetForeground(g_dpy, g_gc_bg, g_bg_pixel);
+static void switch_timeout(void *ctx) {
+    (void)ctx;
+    switch_settle();
+    request_frame(TRIG_TIMER);
+}
 
-    g_gc_focus = XCreateGC(g_dpy, g_win, 0, NULL);
-    XSetForeground(g_dpy, g_gc_focus, g_xc_focus.pixel);
+/* ask the wm to switch, the way pagers do: a _NET_CURRENT_DESKTOP ClientMessage on the root */
+static void ewmh_request_desktop(int ws) {
+    XEvent ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.xclient.type = ClientMessage;
+    ev.xclient.window = g_root;
+    ev.xclient.message_type = g_atoms[NetCurrentDesktop];
+    ev.xclient.format = 32;
+    ev.xclient.data.l[0] = ws - 1;
+    ev.xclient.data.l[1] = (long)g_input_time;
+    XSendEvent(g_dpy, g_root, False, SubstructureNotifyMask | SubstructureRedirectMask, &ev);
+    XFlush(g_dpy);
+}
+
+/* switch workspace: EWMH ClientMessage when the wm publishes desktops, otherwise
+   g_switch_fmt (%d = workspace) if set, else the keybinding through xdotool, both
+   spawned in the background. either way the tag is highlighted right away until
+   the wm confirms (_NET_CURRENT_DESKTOP or focused.workspace) or the timeout */
+static void do_switch(int ws) {
+    if (ws < 1) return;
+    pid_t pid = -1;
+    if (g_ewmh_current > 0 && ws <= g_ewmh_ndesktops) {
+        if (ws == g_ewmh_current && !g_switch_pending) return;
+        ewmh_request_desktop(ws);
+        pid = 0;
+    } else if (g_switch_fmt && strchr(g_switch_fmt, '%')) {
+        char cmdbuf[256];
+        int n = snprintf(cmdbuf, sizeof(cmdbuf), g_switch_fmt, ws);
+        if (n > 0 && n < (int)sizeof(cmdbuf)) pid = spawn_bg(cmdbuf, NULL, NULL);
+    }
+    if (pid < 0) {
+        char try2[64];
+        snprintf(try2, sizeof(try2), "xdotool key super+%d", ws % 10);
+        pid = spawn_bg(try2, NULL, NULL);
+    }
+    if (pid < 0) return;
+    g_switch_pending = ws;
+    timer_arm(&g_switch_timer, now_ms() + SWITCH_CONFIRM_MS);
+}
+
+/* ---------------- line reader ---------------- */
+
+#define LINE_RING_MASK (LINE_RING_SIZE - 1)
+#define LINE_MAX_KEEP (MAX_TEXT - 1)
+
+static void line_reader_reset(LineReader *lr) {
+    lr->head = lr->line_start = 0;
+    lr->overlong = 0;
+}
+
+/* copy len stream bytes starting at offset from the ring (may wrap) */
+static void line_reader_copy(const LineReader *lr, size_t offset, size_t len, char *out) {
+    size_t idx = offset & LINE_RING_MASK;
+    size_t first = LINE_RING_SIZE - idx;
+    if (first > len) first = len;
+    memcpy(out, lr->ring + idx, first);
+    memcpy(out + first, lr->ring, len - first);
+}
+
+/* account for n new bytes at stream offset lr->head (contiguous in the ring).
+   only these bytes are scanned; returns 1 and fills out when a complete line ended in them */
+static int line_reader_feed(LineReader *lr, size_t n, char *out, size_t outlen) {
+    const char *chunk = lr->ring + (lr->head & LINE_RING_MASK);
+    const char *last_nl = memrchr(chunk, '\n', n);
+    size_t cap = outlen - 1 < LINE_MAX_KEEP ? outlen - 1 : LINE_MAX_KEEP;
+    int published = 0;
+
+    if (last_nl) {
+        /* newest complete line: after the previous newline in this chunk, or the pending line */
+        size_t k = (size_t)(last_nl - chunk);
+        const char *prev_nl = memrchr(chunk, '\n', k);
+        size_t len = 0;
+        if (prev_nl) {
+            len = k - (size_t)(prev_nl + 1 - chunk);
+            if (len > cap) len = cap;
+            memcpy(out, prev_nl + 1, len);
+        } else {
+            size_t pending = lr->head - lr->line_start;
+            if (pending > cap) pending = cap;
+            line_reader_copy(lr, lr->line_start, pending, out);
+            len = pending;
+            if (!lr->overlong) {
+                size_t more = k;
+                if (len + more > cap) more = cap - len;
+                memcpy(out + len, chunk, more);
+                len += more;
+            }
+        }
+        out[len] = '\0';
+        published = 1;
+
+        /* what follows the newline starts the new pending line */
+        lr->line_start = lr->head + k + 1;
+        lr->overlong = 0;
+    } else if (lr->overlong) {
+        return 0; /* still inside an over-long line: drop the bytes */
+    }
+
+    lr->head += n;
+    if (lr->head - lr->line_start > LINE_MAX_KEEP) {
+        lr->head = lr->line_start + LINE_MAX_KEEP;
+        lr->overlong = 1;
+    }
+    return published;
+}
+
+/* read fd until EAGAIN. *changed is set when the newest complete line differs from out.
+   returns 0 once the writer is gone (EOF or a hard error) */
+static int line_reader_drain(LineReader *lr, int fd, char *out, size_t outlen, int *changed) {
+    char line[MAX_TEXT];
+    int got = 0;
+    for (;;) {
+        /* the pending line is at most LINE_MAX_KEEP bytes, everything else is free */
+        size_t idx = lr->head & LINE_RING_MASK;
+        size_t room = LINE_RING_SIZE - (lr->head - lr->line_start);
+        size_t contig = LINE_RING_SIZE - idx;
+        if (contig > room) contig = room;
+        ssize_t r = read(fd, lr->ring + idx, contig);
+        if (r > 0) {
+            if (line_reader_feed(lr, (size_t)r, line, sizeof(line) < outlen ? sizeof(line) : outlen))
+                got = 1;
+            continue;
+        }
+        if (r < 0 && errno == EINTR) continue;
+        if (got && strcmp(line, out) != 0) {
+            memcpy(out, line, strlen(line) + 1);
+            *changed = 1;
+        }
+        return r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+static void status_cmd_io(void *ctx, unsigned int events);
+static void status_pid_io(void *ctx, unsigned int events);
+
+static int pidfd_open_compat(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/* spawn the status command with a pipe, nonblocking read end.
+   a built-in status module is refreshed in-process instead */
+static int spawn_status_cmd(void) {
+    if (g_status_mod) {
+        module_update(g_status_mod, g_status_line, sizeof(g_status_line));
+        timer_arm(&g_status_timer, module_next_due(g_status_mod));
+        return 1;
+    }
+    if (!g_cmd || !g_cmd[0]) return 0;
+    int p[2];
+    if (pipe2(p, O_CLOEXEC) < 0) {
+        return 0;
+    }
+
+    /* stdout and stderr both go to the pipe; own process group, so a restart
+       can take down everything the shell started */
+    pid_t pid = spawn_cmd(g_cmd, p[1], p[1], 1);
+    close(p[1]);
+    if (pid < 0) {
+        close(p[0]);
+        return 0;
+    }
+
+    /* make nonblocking */
+    int flags = fcntl(p[0], F_GETFL, 0);
+    if (flags >= 0) fcntl(p[0], F_SETFL, flags | O_NONBLOCK);
+
+    g_cmd_pid = pid;
+    g_cmd_fd = p[0];
+    g_cmd_watch = io_add(g_cmd_fd, status_cmd_io, NULL);
+    g_cmd_pidfd = pidfd_open_compat(pid); /* without pidfd, SIGCHLD reaping covers it */
+    if (g_cmd_pidfd >= 0) {
+        fcntl(g_cmd_pidfd, F_SETFD, FD_CLOEXEC);
+        g_cmd_pid_watch = io_add(g_cmd_pidfd, status_pid_io, NULL);
+    }
+    g_cmd_started = now_ms();
+    g_cmd_kill_sent = 0;
+    if (g_cmd_spawns++) g_cmd_restarts++;
+    line_reader_reset(&g_cmd_reader);
+    g_status_line[0] = '\0';
+    return 1;
+}
+
+static void status_pipe_close(void) {
+    if (g_cmd_fd < 0) return;
+    io_del(g_cmd_watch);
+    g_cmd_watch = NULL;
+    close(g_cmd_fd);
+    g_cmd_fd = -1;
+}
+
+/* SIGTERM what is left of an old status command's process group, and SIGKILL
+   it a second later, so a grandchild ignoring TERM does not outlive restarts.
+   the group is polled meanwhile and forgotten as soon as it is empty, so the
+   SIGKILL never lands on a later group that reused the id */
+static void status_group_term(pid_t pgid) {
+    if (kill(-pgid, SIGTERM) < 0 && errno == ESRCH) return;
+    int n = (int)(sizeof(g_cmd_doomed) / sizeof(g_cmd_doomed[0]));
+    if (g_cmd_doomed[n - 1].pgid) {
+        kill(-g_cmd_doomed[0].pgid, SIGKILL); /* full: the oldest goes now */
+        memmove(g_cmd_doomed, g_cmd_doomed + 1, sizeof(g_cmd_doomed[0]) * (size_t)(n - 1));
+        g_cmd_doomed[n - 1].pgid = 0;
+    }
+    int i = 0;
+    while (g_cmd_doomed[i].pgid) ++i;
+    g_cmd_doomed[i].pgid = pgid;
+    g_cmd_doomed[i].due = now_ms() + 1000;
+    timer_arm(&g_cmd_doomed_timer, now_ms() + 100);
+}
+
+static void status_group_due(void *ctx) {
+    (void)ctx;
+    uint64_t now = now_ms();
+    size_t n = sizeof(g_cmd_doomed) / sizeof(g_cmd_doomed[0]), k = 0;
+    for (size_t i = 0; i < n && g_cmd_doomed[i].pgid; ++i) {
+        pid_t pgid = g_cmd_doomed[i].pgid;
+        g_cmd_doomed[i].pgid = 0;
+        if (kill(-pgid, 0) < 0 && errno == ESRCH) continue; /* empty: nothing to kill */
+        if (now >= g_cmd_doomed[i].due) {
+            kill(-pgid, SIGKILL);
+            continue;
+        }
+        g_cmd_doomed[k].pgid = pgid;
+        g_cmd_doomed[k++].due = g_cmd_doomed[i].due;
+    }
+    if (k) timer_arm(&g_cmd_doomed_timer, now + 100);
+}
+
+/* stop existing cmd (if any) and schedule restart after interval seconds.
+   anything left in its process group is killed */
+static void stop_status_cmd_and_schedule_restart(int status_interval) {
+    status_pipe_close();
+    if (g_cmd_pidfd >= 0) {
+        io_del(g_cmd_pid_watch);
+        g_cmd_pid_watch = NULL;
+        close(g_cmd_pidfd);
+        g_cmd_pidfd = -1;
+    }
+    if (g_cmd_pid > 0) {
+        status_group_term(g_cmd_pid);
+        bg_adopt(g_cmd_pid); /* not reaped yet; the bg table will */
+        g_cmd_pid = -1;
+    }
+    timer_arm(&g_status_timer, now_ms() + (uint64_t)(status_interval > 0 ? status_interval : 1) * 1000);
+}
+
+/* the status command's shell exited with wait status st: kill its leftovers and
+   restart it, after HARD_INTERVAL for a clean exit or an exponential backoff for a crash */
+static void status_cmd_exited(int st) {
+    pid_t pgid = g_cmd_pid;
+    g_cmd_pid = -1;
+    status_group_term(pgid); /* grandchildren that outlived the shell */
+
+    int crashed = WIFSIGNALED(st) ? !g_cmd_kill_sent : (WIFEXITED(st) && WEXITSTATUS(st) != 0);
+    int delay = g_status_interval;
+    if (crashed) {
+        g_cmd_crashes++;
+        uint64_t uptime = now_ms() - g_cmd_started;
+        if (!g_cmd_backoff || uptime >= (uint64_t)HARD_STABLE_UPTIME * 1000)
+            g_cmd_backoff = g_status_interval;
+        else
+            g_cmd_backoff = g_cmd_backoff * 2 > HARD_BACKOFF_MAX ? HARD_BACKOFF_MAX : g_cmd_backoff * 2;
+        delay = g_cmd_backoff;
+    } else {
+        g_cmd_backoff = 0;
+    }
+
+    /* pick up whatever the command printed last before it went */
+    if (g_cmd_fd >= 0) {
+        int changed = 0;
+        line_reader_drain(&g_cmd_reader, g_cmd_fd, g_status_line, sizeof(g_status_line), &changed);
+    }
+    stop_status_cmd_and_schedule_restart(delay);
+    request_frame(TRIG_PIPE);
+}
+
+/* reap the status command if it exited; returns 1 if it did */
+static int status_cmd_try_reap(void) {
+    int st;
+    if (g_cmd_pid <= 0 || waitpid(g_cmd_pid, &st, WNOHANG) <= 0) return 0;
+    status_cmd_exited(st);
+    return 1;
+}
+
+static void status_pid_io(void *ctx, unsigned int events) {
+    (void)ctx; (void)events;
+    status_cmd_try_reap();
+}
+
+/* status deadline: respawn the command, or refresh the built-in module.
+   if the command closed its output but did not exit, escalate SIGTERM -> SIGKILL */
+static void status_due(void *ctx) {
+    (void)ctx;
+    if (g_cmd_pid > 0 && g_cmd_fd < 0) {
+        g_cmd_kill_sent = g_cmd_kill_sent ? 2 : 1;
+        kill(-g_cmd_pid, g_cmd_kill_sent == 1 ? SIGTERM : SIGKILL);
+        timer_arm(&g_status_timer, now_ms() + 1000);
+        return;
+    }
+    if (g_cmd_fd >= 0) return;
+    if (!spawn_status_cmd())
+        timer_arm(&g_status_timer, now_ms() + (uint64_t)g_status_interval * 1000);
+    request_frame(TRIG_TIMER);
+}
+
+/* status command output is readable (or hung up): drain it and keep only the newest line */
+static void status_cmd_io(void *ctx, unsigned int events) {
+    (void)ctx; (void)events;
+    if (g_cmd_fd < 0) return;
+    int changed = 0;
+    uint64_t t0 = now_us();
+    int open = line_reader_drain(&g_cmd_reader, g_cmd_fd, g_status_line, sizeof(g_status_line), &changed);
+    hist_add(&g_hist_read, now_us() - t0);
+    if (!open) {
+        /* EOF or error: the restart is scheduled once the shell has exited;
+           give it a second before its process group gets killed */
+        status_pipe_close();
+        if (!status_cmd_try_reap()) timer_arm(&g_status_timer, now_ms() + 1000);
+        changed = 1;
+    }
+    if (changed) request_frame(TRIG_PIPE);
+}
+
+/* ---------------- segments ---------------- */
+
+#define FP_SEED 1469598103934665603ULL
+
+/* FNV-1a over len bytes, chained from h */
+static uint64_t fp_bytes(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/* record a segment's new input fingerprint; returns 1 if it needs re-measuring */
+static int segment_check(Segment *sg, uint64_t fp) {
+    if (sg->measured && sg->fp == fp) return 0;
+    sg->fp = fp;
+    sg->measured = 1;
+    return 1;
+}
+
+/* every counter and histogram as one JSON object */
+static void stats_json(FILE *f) {
+    double up = (double)(now_ms() - g_start_ms) / 1000.0;
+    if (up <= 0) up = 1e-3;
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    long rss_kb = 0;
+    FILE *sm = fopen("/proc/self/statm", "re");
+    if (sm) {
+        long pages;
+        if (fscanf(sm, "%*s %ld", &pages) == 1) rss_kb = pages * (sysconf(_SC_PAGESIZE) / 1024);
+        fclose(sm);
+    }
+    unsigned long frames = g_frames_painted + g_frames_skipped;
+    fprintf(f, "{\"uptime_s\":%.3f,", up);
+    fprintf(f, "\"frames\":{\"painted\":%lu,\"skipped\":%lu,\"rendered\":%lu,\"coalesced\":%lu,\"dropped\":%lu},",
+            g_frames_painted, g_frames_skipped, g_updates_rendered, g_updates_coalesced, g_updates_dropped);
+    fprintf(f, "\"fps\":%.2f,", (double)g_updates_rendered / up);
+    fprintf(f, "\"triggers\":{");
+    for (int i = 0; i < TRIG_COUNT; ++i)
+        fprintf(f, "%s\"%s\":%lu", i ? "," : "", g_trigger_names[i], g_triggers[i]);
+    fprintf(f, "},");
+    hist_json(f, "draw_us", &g_hist_draw);
+    fprintf(f, ",\"phases_us\":{");
+    for (int i = 0; i < PH_COUNT; ++i) {
+        if (i) fputc(',', f);
+        hist_json(f, g_phase_names[i], &g_hist_phase[i]);
+    }
+    fputc('}', f);
+    fputc(',', f);
+    hist_json(f, "spawn_us", &g_hist_spawn);
+    fputc(',', f);
+    hist_json(f, "read_us", &g_hist_read);
+    fprintf(f, ",\"backend\":\"%s\"", X_BACKEND);
+    fprintf(f, ",\"roundtrips\":{\"last_frame\":%lu,\"total\":%lu},", g_rt_last, g_rt_total);
+    fprintf(f, "\"roundtrips_per_frame\":%.3f,", frames ? (double)g_rt_total / frames : 0.0);
+    fprintf(f, "\"text_cache\":{\"hits\":%lu,\"misses\":%lu},", g_text_hits, g_text_misses);
+    fprintf(f, "\"color_cache\":{\"hits\":%lu,\"misses\":%lu},", g_color_hits, g_color_misses);
+    fprintf(f, "\"marquee_steps\":%lu,", g_marquee_steps);
+    fprintf(f, "\"spawns\":%lu,\"spawns_per_min\":%.2f,", g_spawns, g_spawns * 60.0 / up);
+    fprintf(f, "\"status_cmd\":{\"spawns\":%lu,\"restarts\":%lu,\"crashes\":%lu,\"backoff_s\":%d},",
+            g_cmd_spawns, g_cmd_restarts, g_cmd_crashes, g_cmd_backoff);
+    fprintf(f, "\"rss_kb\":%ld,\"maxrss_kb\":%ld,", rss_kb, ru.ru_maxrss);
+    fprintf(f, "\"cpu_user_s\":%.3f,\"cpu_sys_s\":%.3f}\n",
+            ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6, ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6);
+}
+
+/* SIGUSR1: the JSON stats to --stats FILE if given, else stderr */
+static void dump_stats(void) {
+    FILE *f = g_stats_path ? fopen(g_stats_path, "we") : NULL;
+    stats_json(f ? f : stderr);
+    if (f) fclose(f);
+    else fflush(stderr);
+}
+
+/* ---------------- text layout cache ---------------- */
+
+static void text_layout_free(TextLayout *tl) {
+    free(tl->text);
+    free(tl->glyphs);
+    memset(tl, 0, sizeof(*tl));
+}
+
+/* drop every layout, e.g. after the font changed */
+static void text_cache_clear(void) {
+    for (int i = 0; i < TEXT_CACHE_SIZE; ++i) text_layout_free(&g_text_cache[i]);
+}
+
+/* shape s once: resolve glyph indices and pen positions relative to origin 0,0 */
+static int text_layout_build(TextLayout *tl, XftFont *font, const char *s, size_t len) {
+    tl->text = malloc(len + 1);
+    tl->glyphs = malloc(sizeof(XftGlyphFontSpec) * (len ? len : 1));
+    if (!tl->text || !tl->glyphs) { text_layout_free(tl); return 0; }
+    memcpy(tl->text, s, len);
+    tl->text[len] = '\0';
+    tl->len = len;
+    tl->font = font;
+
+    int pen = 0, n = 0;
+    const FcChar8 *p = (const FcChar8 *)s;
+    int left = (int)len;
+    while (left > 0) {
+        FcChar32 ucs;
+        int used = FcUtf8ToUcs4(p, &ucs, left);
+        if (used <= 0) { used = 1; ucs = 0xfffd; } /* invalid byte: replacement char */
+        p += used;
+        left -= used;
+        FT_UInt g = XftCharIndex(g_dpy, font, ucs);
+        XGlyphInfo gi;
+        XftGlyphExtents(g_dpy, font, &g, 1, &gi);
+        tl->glyphs[n].font = font;
+        tl->glyphs[n].glyph = g;
+        tl->glyphs[n].x = (short)pen;
+        tl->glyphs[n].y = 0;
+        pen += gi.xOff;
+        n++;
+    }
+    tl->nglyphs = n;
+    tl->ox = tl->oy = 0;
+
+    memset(&tl->ext, 0, sizeof(tl->ext));
+    if (n > 0) {
+        FT_UInt gbuf[MAX_TEXT];
+        int m = n < MAX_TEXT ? n : MAX_TEXT;
+        for (int i = 0; i < m; ++i) gbuf[i] = tl->glyphs[i].glyph;
+        XftGlyphExtents(g_dpy, font, gbuf, m, &tl->ext);
+    }
+    tl->ext.xOff = (short)pen;
+    return 1;
+}
+
+/* cached layout for s in font; evicts the least recently used entry on a miss */
+static TextLayout *text_layout(XftFont *font, const char *s, size_t len) {
+    uint64_t key = fp_bytes(fp_bytes(FP_SEED, &font, sizeof(font)), s, len);
+    TextLayout *victim = &g_text_cache[0];
+    for (int i = 0; i < TEXT_CACHE_SIZE; ++i) {
+        TextLayout *tl = &g_text_cache[i];
+        if (tl->last_use && tl->key == key && tl->font == font &&
+            tl->len == len && memcmp(tl->text, s, len) == 0) {
+            tl->last_use = ++g_text_clock;
+            g_text_hits++;
+            return tl;
+        }
+        if (tl->last_use < victim->last_use) victim = tl;
+    }
+    g_text_misses++;
+    text_layout_free(victim);
+    if (!text_layout_build(victim, font, s, len)) return NULL;
+    victim->key = key;
+    victim->last_use = ++g_text_clock;
+    return victim;
+}
+
+static int text_width(XftFont *font, const char *s, size_t len) {
+    TextLayout *tl = text_layout(font, s, len);
+    return tl ? tl->ext.xOff : 0;
+}
+
+/* positions are only rewritten when the origin moves */
+static void text_layout_move(TextLayout *tl, int x, int y) {
+    if (tl->ox == x && tl->oy == y) return;
+    short dx = (short)(x - tl->ox), dy = (short)(y - tl->oy);
+    for (int i = 0; i < tl->nglyphs; ++i) {
+        tl->glyphs[i].x += dx;
+        tl->glyphs[i].y += dy;
+    }
+    tl->ox = x;
+    tl->oy = y;
+}
+
+/* pen offset of glyph i from the text start; i == nglyphs is the full advance */
+static int text_pen(const TextLayout *tl, int i) {
+    return i < tl->nglyphs ? tl->glyphs[i].x - tl->ox : tl->ext.xOff;
+}
+
+/* the last glyph boundary at or before px, by binary search over the cached
+   pen positions: glyphs [0, result) end by px. nothing is measured again */
+static int text_glyph_at(const TextLayout *tl, int px) {
+    int lo = 0, hi = tl->nglyphs;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (text_pen(tl, mid) <= px) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+/* draw from the cached glyph specs */
+static void text_draw(XftDraw *draw, const XftColor *color, XftFont *font,
+                      int x, int y, const char *s, size_t len) {
+    TextLayout *tl = text_layout(font, s, len);
+    if (!tl || tl->nglyphs == 0) return;
+    text_layout_move(tl, x, y);
+    XftDrawGlyphFontSpec(draw, color, tl->glyphs, tl->nglyphs);
+}
+
+/* tag numbers and the ellipsis never change, measure them once per font */
+static void tag_widths_init(void) {
+    for (int i = 1; i <= MAX_WS; ++i) {
+        char tb[12];
+        snprintf(tb, sizeof(tb), "%d", i);
+        g_tag_w[i] = text_width(g_font, tb, strlen(tb));
+    }
+    g_ellipsis = XftCharExists(g_dpy, g_font, 0x2026) ? "\xe2\x80\xa6" : "...";
+    g_ellipsis_w = text_width(g_font, g_ellipsis, strlen(g_ellipsis));
+}
+
+/* ---------------- markup ---------------- */
+
+/* #rgb, #rrggbb or #rrggbbaa as 0xrrggbbaa. parsed here, not by XParseColor,
+   so a frame never waits on the server for a color name */
+static int markup_rgba(const char *s, int len, uint32_t *out) {
+    if (len < 1 || s[0] != '#') return 0;
+    s++;
+    len--;
+    if (len != 3 && len != 6 && len != 8) return 0;
+    uint32_t v = 0;
+    for (int i = 0; i < len; ++i) {
+        int c = (unsigned char)s[i];
+        if (!isxdigit(c)) return 0;
+        uint32_t d = (uint32_t)(isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+        v = v << 4 | d;
+        if (len == 3) v = v << 4 | d;
+    }
+    if (len != 8) v = v << 8 | 0xff;
+    *out = v;
+    return 1;
+}
+
+/* the XftColor for rgba, allocated on first use; NULL once the table is full */
+static const XftColor *color_get(uint32_t rgba) {
+    uint32_t h = (rgba * 2654435761u) >> 20;
+    for (int i = 0; i < COLOR_CACHE_SIZE; ++i) {
+        ColorSlot *c = &g_color_cache[(h + (uint32_t)i) & (COLOR_CACHE_SIZE - 1)];
+        if (c->used && c->rgba == rgba) {
+            g_color_hits++;
+            return &c->color;
+        }
+        if (c->used) continue;
+        XRenderColor rc;
+        rc.red = (unsigned short)((rgba >> 24 & 0xff) * 0x101);
+        rc.green = (unsigned short)((rgba >> 16 & 0xff) * 0x101);
+        rc.blue = (unsigned short)((rgba >> 8 & 0xff) * 0x101);
+        rc.alpha = (unsigned short)((rgba & 0xff) * 0x101);
+        if (!XftColorAllocValue(g_dpy, DefaultVisual(g_dpy, g_scr), g_cmap, &rc, &c->color)) return NULL;
+        c->used = 1;
+        c->rgba = rgba;
+        g_color_misses++;
+        return &c->color;
+    }
+    return NULL;
+}
+
+static XftFont *markup_font(const char *name, int len) {
+    if (len <= 0 || len >= (int)sizeof(g_markup_fonts[0].name)) return g_font;
+    for (int i = 0; i < MAX_MARKUP_FONTS; ++i) {
+        MarkupFont *mf = &g_markup_fonts[i];
+        if (!mf->name[0]) {
+            memcpy(mf->name, name, (size_t)len);
+            mf->name[len] = '\0';
+            mf->font = XftFontOpenName(g_dpy, g_scr, mf->name);
+            if (!mf->font) fprintf(stderr, "markup: cannot open font %s\n", mf->name);
+        } else if (strncmp(mf->name, name, (size_t)len) != 0 || mf->name[len]) {
+            continue;
+        }
+        return mf->font ? mf->font : g_font;
+    }
+    return g_font;
+}
+
+static void markup_fonts_close(void) {
+    for (int i = 0; i < MAX_MARKUP_FONTS; ++i)
+        if (g_markup_fonts[i].font) XftFontClose(g_dpy, g_markup_fonts[i].font);
+    memset(g_markup_fonts, 0, sizeof(g_markup_fonts));
+}
+
+/* append s[0..len) as a run in style */
+static void markup_push(TextRuns *r, const char *s, int len, const TextRun *style) {
+    if (len <= 0 || r->n == MAX_RUNS) return;
+    TextRun *run = &r->run[r->n++];
+    *run = *style;
+    run->s = s;
+    run->len = len;
+}
+
+/* split s into runs at
+     ^fg(#rrggbb) ^bg(#rrggbb) ^font(name)   style; an empty argument restores the default
+     ^ca(BUTTON,CMD) ... ^ca()               click action for BUTTON (1-5), nestable
+     ^r()                                    back to the default style, no actions
+   ^^ is a literal caret, anything else stays text. CMD ends at the first ')'.
+   one pass, no allocation: runs point into s */
+static void markup_parse(TextRuns *r, const char *s) {
+    static const char *tags[] = { "fg(", "bg(", "font(", "ca(", "r(" };
+    struct { int button; const char *cmd; int len; } ca[MAX_CA_DEPTH];
+    int ca_n = 0;
+    TextRun style;
+    memset(&style, 0, sizeof(style));
+    style.font = g_font;
+    const char *run = s, *p = s;
+    r->n = 0;
+    while ((p = strchr(p, '^'))) {
+        if (p[1] == '^') {
+            markup_push(r, run, (int)(p + 1 - run), &style);
+            run = p = p + 2;
+            continue;
+        }
+        int kind = -1;
+        const char *arg = NULL, *end = NULL;
+        for (int k = 0; k < 5 && kind < 0; ++k) {
+            size_t tl = strlen(tags[k]);
+            if (strncmp(p + 1, tags[k], tl) != 0) continue;
+            arg = p + 1 + tl;
+            end = strchr(arg, ')');
+            kind = k;
+        }
+        if (kind < 0 || !end) { p++; continue; }
+        markup_push(r, run, (int)(p - run), &style);
+        int alen = (int)(end - arg);
+        uint32_t rgba;
+        if (kind == 0 || kind == 1) {
+            const XftColor *c = alen && markup_rgba(arg, alen, &rgba) ? color_get(rgba) : NULL;
+            if (kind == 0) style.fg = c;
+            else style.bg = c;
+        } else if (kind == 2) {
+            style.font = alen ? markup_font(arg, alen) : g_font;
+        } else {
+            if (kind == 4) {
+                memset(&style, 0, sizeof(style));
+                style.font = g_font;
+                ca_n = 0;
+            } else if (!alen) {
+                if (ca_n) ca_n--;
+            } else if (ca_n < MAX_CA_DEPTH && arg[0] >= '1' && arg[0] < '1' + CLICK_BUTTONS && arg[1] == ',') {
+                ca[ca_n].button = arg[0] - '0';
+                ca[ca_n].cmd = arg + 2;
+                ca[ca_n].len = alen - 2;
+                ca_n++;
+            }
+            /* innermost action per button wins */
+            memset(style.act, 0, sizeof(style.act));
+            for (int i = 0; i < ca_n; ++i) {
+                style.act[ca[i].button - 1] = ca[i].cmd;
+                style.act_len[ca[i].button - 1] = (short)ca[i].len;
+            }
+        }
+        run = p = end + 1;
+    }
+    markup_push(r, run, (int)strlen(run), &style);
+}
+
+/* runs and advances for s; reused as long as s and the font are unchanged */
+static void markup_layout(TextRuns *r, const char *s) {
+    uint64_t fp = fp_bytes(fp_bytes(FP_SEED, &g_font, sizeof(g_font)), s, strlen(s));
+    if (r->src == s && r->fp == fp) return;
+    r->src = s;
+    r->fp = fp;
+    if (!strchr(s, '^')) {
+        /* plain text, the common case: one run in the default style */
+        TextRun style;
+        memset(&style, 0, sizeof(style));
+        style.font = g_font;
+        r->n = 0;
+        markup_push(r, s, (int)strlen(s), &style);
+    } else {
+        markup_parse(r, s);
+    }
+    r->w = 0;
+    for (int i = 0; i < r->n; ++i) {
+        TextRun *run = &r->run[i];
+        run->x = r->w;
+        run->w = text_width(run->font, run->s, (size_t)run->len);
+        r->w += run->w;
+    }
+}
+
+/* glyphs [g0, g1) of run, drawn with the run's origin at x,y */
+static void run_draw(XftDraw *draw, const XftColor *color, const TextRun *run, int x, int y, int g0, int g1) {
+    TextLayout *tl = g0 < g1 ? text_layout(run->font, run->s, (size_t)run->len) : NULL;
+    if (!tl) return;
+    if (g1 > tl->nglyphs) g1 = tl->nglyphs;
+    if (g0 >= g1) return;
+    text_layout_move(tl, x, y);
+    XftDrawGlyphFontSpec(draw, color, tl->glyphs + g0, g1 - g0);
+}
+
+/* glyphs [g0[i], g1[i]) of the first n runs: backgrounds (up to bg_end), then
+   every shadow, then the text, so no run's shadow covers its neighbour's glyphs */
+static void runs_paint(XftDraw *draw, const TextRuns *r, int x, int y,
+                       const int *g0, const int *g1, int n, int bg_end) {
+    for (int i = 0; i < n; ++i) {
+        const TextRun *run = &r->run[i];
+        int w = MIN(run->x + run->w, bg_end) - run->x;
+        if (run->bg && w > 0) XftDrawRect(draw, run->bg, x + run->x, 0, (unsigned)w, (unsigned)g_bar_h);
+    }
+    for (int i = 0; i < n; ++i)
+        run_draw(draw, &g_xft_shadow, &r->run[i], x + r->run[i].x + 1, y + 1, g0[i], g1[i]);
+    for (int i = 0; i < n; ++i)
+        run_draw(draw, r->run[i].fg ? r->run[i].fg : &g_xft_fg, &r->run[i], x + r->run[i].x, y, g0[i], g1[i]);
+}
+
+/* r at x, at most max_w wide: text that does not fit ends at the last whole
+   glyph that leaves room for an ellipsis, found from the cached advances */
+static void markup_draw(XftDraw *draw, const TextRuns *r, int x, int y, int max_w) {
+    int g0[MAX_RUNS] = { 0 }, g1[MAX_RUNS];
+    for (int i = 0; i < r->n; ++i) g1[i] = INT_MAX;
+    if (r->w <= max_w) {
+        runs_paint(draw, r, x, y, g0, g1, r->n, r->w);
+        return;
+    }
+    int limit = MAX(max_w - g_ellipsis_w, 0), n = 0;
+    while (n < r->n - 1 && r->run[n].x + r->run[n].w <= limit) ++n;
+    const TextRun *cut = &r->run[n];
+    TextLayout *tl = text_layout(cut->font, cut->s, (size_t)cut->len);
+    int end = cut->x;
+    if (tl) {
+        g1[n] = text_glyph_at(tl, limit - cut->x);
+        end += text_pen(tl, g1[n]);
+    }
+    runs_paint(draw, r, x, y, g0, g1, n + 1, end + g_ellipsis_w);
+    text_draw(draw, &g_xft_shadow, g_font, x + end + 1, y + 1, g_ellipsis, strlen(g_ellipsis));
+    text_draw(draw, cut->fg ? cut->fg : &g_xft_fg, g_font, x + end, y, g_ellipsis, strlen(g_ellipsis));
+}
+
+/* r at x, but only the glyphs that reach into [lo, hi); the caller clips */
+static void markup_draw_span(XftDraw *draw, const TextRuns *r, int x, int y, int lo, int hi) {
+    int g0[MAX_RUNS], g1[MAX_RUNS];
+    for (int i = 0; i < r->n; ++i) {
+        const TextRun *run = &r->run[i];
+        int rx = x + run->x;
+        TextLayout *tl = rx < hi + 2 && rx + run->w > lo - 2 ?
+                         text_layout(run->font, run->s, (size_t)run->len) : NULL;
+        g0[i] = g1[i] = 0;
+        if (!tl || !tl->nglyphs) continue;
+        /* a couple of pixels of slack for the shadow and glyphs that overhang */
+        g0[i] = text_glyph_at(tl, lo - 2 - rx);
+        if (g0[i] == tl->nglyphs) g0[i]--;
+        g1[i] = text_glyph_at(tl, hi + 2 - rx) + 1;
+    }
+    runs_paint(draw, r, x, y, g0, g1, r->n, r->w);
+}
+
+/* join right side pieces with two spaces; a piece's markup ends with it.
+   ipc and shm pieces come from other processes (trusted = 0): they keep their
+   style tags, but a ^ca() becomes literal text, so they cannot run commands */
+static void right_append(char *buf, size_t len, const char *piece, int trusted) {
+    if (buf[0]) strncat(buf, "  ", len - strlen(buf) - 1);
+    int markup = strchr(piece, '^') != NULL;
+    size_t start = strlen(buf), n = start;
+    /* a piece with markup is cut short rather than lose its ^r() */
+    size_t room = len - 1 - (markup ? 4 : 0);
+    if (room < start) room = start;
+    const char *p = piece;
+    for (; *p && n < room; ++p) {
+        /* a doubled caret is never split by the end of buf */
+        if (p[0] == '^' && p[1] == '^') {
+            if (n + 2 > room) break;
+            buf[n++] = *p++;
+        } else if (!trusted && strncmp(p, "^ca(", 4) == 0) {
+            if (n + 2 > room) break;
+            buf[n++] = '^';
+        }
+        buf[n++] = *p;
+    }
+    if (markup && n > start) {
+        /* a caret after the piece's last ')' would take the reset's ')' for its
+           own: escape those, or cut them off with the rest of a cut piece */
+        size_t first = n;
+        int loose = 0;
+        for (size_t i = start; i < n; ++i) {
+            if (buf[i] == ')') { first = n; loose = 0; }
+            else if (buf[i] == '^' && i + 1 < n && buf[i + 1] == '^') ++i;
+            else if (buf[i] == '^') { if (first == n) first = i; loose++; }
+        }
+        char tail[MAX_TEXT];
+        if (loose && (*p || n + (size_t)loose > room || n - first > sizeof(tail))) {
+            n = first;
+        } else if (loose) {
+            size_t tn = n - first;
+            memcpy(tail, buf + first, tn);
+            n = first;
+            for (size_t i = 0; i < tn; ++i) {
+                if (tail[i] == '^' && i + 1 < tn && tail[i + 1] == '^') buf[n++] = tail[i++];
+                else if (tail[i] == '^') buf[n++] = '^';
+                buf[n++] = tail[i];
+            }
+        }
+        memcpy(buf + n, "^r()", 4);
+        n += 4;
+    }
+    buf[n] = '\0';
+}
+
+/* ---------------- back buffer ---------------- */
+
+/* (re)create b's back buffer pixmap when its output width or the bar height changed.
+   it covers the whole output width so content driven window resizes don't touch it */
+static void backbuf_ensure(Bar *b) {
+    if (b->back && b->back_w == b->ow && b->back_h == g_bar_h) return;
+    if (b->back_draw) XftDrawDestroy(b->back_draw);
+    if (b->back) XFreePixmap(g_dpy, b->back);
+    b->back_w = b->ow;
+    b->back_h = g_bar_h;
+    b->back = XCreatePixmap(g_dpy, b->win, b->back_w, b->back_h, DefaultDepth(g_dpy, g_scr));
+    b->back_draw = XftDrawCreate(g_dpy, b->back, DefaultVisual(g_dpy, g_scr), g_cmap);
+    XFillRectangle(g_dpy, b->back, g_gc_bg, 0, 0, b->back_w, b->back_h);
+    b->frame_valid = 0; /* nothing valid in the new buffer yet */
+}
+
+static void backbuf_free(Bar *b) {
+    if (b->back_draw) XftDrawDestroy(b->back_draw);
+    if (b->back) XFreePixmap(g_dpy, b->back);
+    b->back_draw = NULL;
+    b->back = None;
+}
+
+/* serve an Expose from the back buffer without re-rendering */
+static void backbuf_expose(Bar *b, int x, int y, int w, int h) {
+    if (!b->back || !b->frame_valid) { draw_all(); return; }
+    XCopyArea(g_dpy, b->back, b->win, g_gc_bg, x, y, w, h, x, y);
+}
+
+static void damage_reset(void) {
+    g_damage_n = 0;
+}
+
+/* add a full-height span [x, x+w) clamped to b's back buffer, merging overlaps */
+static void damage_add(Bar *b, int x, int w) {
+    if (x < 0) { w += x; x = 0; }
+    if (x + w > b->back_w) w = b->back_w - x;
+    if (w <= 0) return;
+    for (int i = 0; i < g_damage_n; ++i) {
+        XRectangle *r = &g_damage[i];
+        if (x <= r->x + r->width && r->x <= x + w) {
+            int nx = x < r->x ? x : r->x;
+            int ne = MAX(x + w, r->x + r->width);
+            /* re-add the merged span so chains of overlaps collapse too */
+            g_damage[i] = g_damage[--g_damage_n];
+            damage_add(b, nx, ne - nx);
+            return;
+        }
+    }
+    if (g_damage_n == MAX_DAMAGE) {
+        /* out of slots: fold everything into one bounding span */
+        int nx = x, ne = x + w;
+        for (int i = 0; i < g_damage_n; ++i) {
+            if (g_damage[i].x < nx) nx = g_damage[i].x;
+            ne = MAX(ne, g_damage[i].x + g_damage[i].width);
+        }
+        g_damage_n = 0;
+        x = nx; w = ne - nx;
+    }
+    g_damage[g_damage_n].x = (short)x;
+    g_damage[g_damage_n].y = 0;
+    g_damage[g_damage_n].width = (unsigned short)w;
+    g_damage[g_damage_n].height = (unsigned short)g_bar_h;
+    g_damage_n++;
+}
+
+static int damage_hits(int x, int w) {
+    for (int i = 0; i < g_damage_n; ++i)
+        if (x < g_damage[i].x + g_damage[i].width && g_damage[i].x < x + w) return 1;
+    return 0;
+}
+
+/* restrict back buffer drawing to the damage (on) or lift the restriction (off) */
+static void damage_clip(Bar *b, int on) {
+    if (on) {
+        XftDrawSetClipRectangles(b->back_draw, 0, 0, g_damage, g_damage_n);
+        XSetClipRectangles(g_dpy, g_gc_bg, 0, 0, g_damage, g_damage_n, Unsorted);
+        XSetClipRectangles(g_dpy, g_gc_focus, 0, 0, g_damage, g_damage_n, Unsorted);
+    } else {
+        XftDrawSetClip(b->back_draw, None);
+        XSetClipMask(g_dpy, g_gc_bg, None);
+        XSetClipMask(g_dpy, g_gc_focus, None);
+    }
+}
+
+/* end of a frame: publish the round trips made since the previous one */
+static void frame_done(void) {
+    g_rt_last = g_rt_frame;
+    g_rt_total += g_rt_frame;
+    g_rt_frame = 0;
+}
+
+/* ---------------- bars ---------------- */
+
+static Bar *bar_find(Window w) {
+    for (int i = 0; i < g_bars_n; ++i)
+        if (g_bars[i].win == w) return &g_bars[i];
+    return NULL;
+}
+
+/* the bar's window, dock properties and strut for its output */
+static void bar_create(Bar *b) {
+    XSetWindowAttributes wa;
+    wa.override_redirect = False;
+    wa.background_pixel = g_bg_pixel; /* ensure window background matches requested bg */
+    wa.bit_gravity = NorthWestGravity; /* keep contents on resize, the back buffer fills the rest */
+    wa.event_mask = ExposureMask | ButtonPressMask | StructureNotifyMask;
+    /* created at its final size where that is known, so the first map already shows the bar */
+    int w = g_fullscreen ? b->ow : MIN(200, b->ow);
+    b->win = XCreateWindow(g_dpy, g_root, b->ox + (b->ow - w) / 2, b->oy, w, g_bar_h, 0, DefaultDepth(g_dpy, g_scr),
+                           CopyFromParent, DefaultVisual(g_dpy, g_scr),
+                           CWBackPixel | CWBitGravity | CWEventMask, &wa);
+
+    Atom a_type = g_atoms[NetWMWindowType];
+    Atom a_type_dock = g_atoms[NetWMWindowTypeDock];
+    if (a_type && a_type_dock)
+        XChangeProperty(g_dpy, b->win, a_type, XA_ATOM, 32, PropModeReplace,
+                       (unsigned char *)&a_type_dock, 1);
+
+    Atom a_state = g_atoms[NetWMState];
+    Atom a_state_above = g_atoms[NetWMStateAbove];
+    Atom a_state_sticky = g_atoms[NetWMStateSticky];
+    Atom states[2];
+    int nstates = 0;
+    if (a_state_above) states[nstates++] = a_state_above;
+    if (a_state_sticky) states[nstates++] = a_state_sticky;
+    if (nstates && a_state)
+        XChangeProperty(g_dpy, b->win, a_state, XA_ATOM, 32, PropModeReplace,
+                        (unsigned char*)states, nstates);
+
+    Atom a_pid = g_atoms[NetWMPid];
+    if (a_pid) {
+        unsigned long pid = (unsigned long)getpid();
+        XChangeProperty(g_dpy, b->win, a_pid, XA_CARDINAL, 32, PropModeReplace,
+                        (unsigned char*)&pid, 1);
+    }
+
+    set_strut(g_dpy, b->win, b->oy + g_bar_h, b->ox, b->ox + b->ow - 1);
+    XMapWindow(g_dpy, b->win);
+}
+
+static void bar_destroy(Bar *b) {
+    backbuf_free(b);
+    if (b->win) XDestroyWindow(g_dpy, b->win);
+    b->win = None;
+}
+
+#if defined(XCB) && defined(XRANDR)
+/* the Xlib walk below, but all outputs and then all crtcs are asked for at once:
+   three round trips however many outputs there are */
+static int outputs_query_xcb(OutputGeom *out, int max) {
+    xcb_connection_t *c = XGetXCBConnection(g_dpy);
+    xcb_randr_get_screen_resources_current_reply_t *res = xcb_randr_get_screen_resources_current_reply(
+        c, xcb_randr_get_screen_resources_current(c, (xcb_window_t)g_root), NULL);
+    if (!res) return 0;
+    xcb_randr_output_t *outputs = xcb_randr_get_screen_resources_current_outputs(res);
+    int no = MIN(xcb_randr_get_screen_resources_current_outputs_length(res), XREQ_BATCH);
+    xcb_randr_get_output_info_cookie_t ock[XREQ_BATCH];
+    for (int i = 0; i < no; ++i)
+        ock[i] = xcb_randr_get_output_info(c, outputs[i], res->config_timestamp);
+
+    xcb_randr_output_t lit[XREQ_BATCH];
+    xcb_randr_get_crtc_info_cookie_t cck[XREQ_BATCH];
+    int nl = 0;
+    for (int i = 0; i < no; ++i) {
+        xcb_randr_get_output_info_reply_t *oi = xcb_randr_get_output_info_reply(c, ock[i], NULL);
+        if (oi && oi->connection == XCB_RANDR_CONNECTION_CONNECTED && oi->crtc) {
+            lit[nl] = outputs[i];
+            cck[nl++] = xcb_randr_get_crtc_info(c, oi->crtc, res->config_timestamp);
+        }
+        free(oi);
+    }
+
+    int n = 0;
+    for (int i = 0; i < nl; ++i) {
+        xcb_randr_get_crtc_info_reply_t *ci = xcb_randr_get_crtc_info_reply(c, cck[i], NULL);
+        int dup = 0;
+        for (int j = 0; ci && j < n; ++j)
+            dup |= out[j].x == ci->x && out[j].y == ci->y;
+        if (ci && !dup && ci->width && ci->height && n < max) {
+            out[n].output = lit[i];
+            out[n].x = ci->x;
+            out[n].y = ci->y;
+            out[n].w = ci->width;
+            out[n].h = ci->height;
+            n++;
+        }
+        free(ci);
+    }
+    free(res);
+    return n;
+}
+#endif
+
+/* outputs currently lit, mirrors collapsed; the whole screen without XRandR */
+static int outputs_query(OutputGeom *out, int max) {
+    int n = 0;
+#if defined(XCB) && defined(XRANDR)
+    if (g_rr_event >= 0) n = outputs_query_xcb(out, max);
+#elif defined(XRANDR)
+    if (g_rr_event >= 0) {
+        XRRScreenResources *res = XRRGetScreenResourcesCurrent(g_dpy, g_root);
+        for (int i = 0; res && i < res->noutput && n < max; ++i) {
+            XRROutputInfo *oi = XRRGetOutputInfo(g_dpy, res, res->outputs[i]);
+            if (oi && oi->connection == RR_Connected && oi->crtc) {
+                XRRCrtcInfo *ci = XRRGetCrtcInfo(g_dpy, res, oi->crtc);
+                int dup = 0;
+                for (int j = 0; ci && j < n; ++j)
+                    dup |= out[j].x == ci->x && out[j].y == ci->y;
+                if (ci && !dup && ci->width && ci->height) {
+                    out[n].output = res->outputs[i];
+                    out[n].x = ci->x;
+                    out[n].y = ci->y;
+                    out[n].w = (int)ci->width;
+                    out[n].h = (int)ci->height;
+                    n++;
+                }
+                if (ci) XRRFreeCrtcInfo(ci);
+            }
+            if (oi) XRRFreeOutputInfo(oi);
+        }
+        if (res) XRRFreeScreenResources(res);
+    }
+#endif
+    if (n == 0) {
+        out[0].output = 0;
+        out[0].x = out[0].y = 0;
+        out[0].w = DisplayWidth(g_dpy, g_scr);
+        out[0].h = DisplayHeight(g_dpy, g_scr);
+        n = 1;
+    }
+    return n;
+}
+
+/* sync the bars with the outputs: bars of unplugged outputs go, new outputs get a
+   bar, a moved or resized output only gets its own bar reconfigured */
+static void bars_update(void) {
+    OutputGeom outs[MAX_BARS];
+    int n = outputs_query(outs, MAX_BARS);
+
+    for (int i = 0; i < g_bars_n; ) {
+        Bar *b = &g_bars[i];
+        int keep = 0;
+        for (int j = 0; j < n && !keep; ++j) keep = outs[j].output == b->output;
+        if (keep) { ++i; continue; }
+        bar_destroy(b);
+        g_bars[i] = g_bars[--g_bars_n];
+    }
+
+    for (int j = 0; j < n; ++j) {
+        Bar *b = NULL;
+        for (int i = 0; i < g_bars_n && !b; ++i)
+            if (g_bars[i].output == outs[j].output) b = &g_bars[i];
+        if (b) {
+            if (b->ox == outs[j].x && b->oy == outs[j].y && b->ow == outs[j].w && b->oh == outs[j].h)
+                continue;
+            b->ox = outs[j].x; b->oy = outs[j].y;
+            b->ow = outs[j].w; b->oh = outs[j].h;
+            b->win_x = -1;      /* force a configure */
+            b->frame_valid = 0;
+            set_strut(g_dpy, b->win, b->oy + g_bar_h, b->ox, b->ox + b->ow - 1);
+            continue;
+        }
+        if (g_bars_n == MAX_BARS) break;
+        b = &g_bars[g_bars_n++];
+        memset(b, 0, sizeof(*b));
+        b->output = outs[j].output;
+        b->ox = outs[j].x; b->oy = outs[j].y;
+        b->ow = outs[j].w; b->oh = outs[j].h;
+        b->win_x = b->win_w = b->win_h = -1;
+        bar_create(b);
+    }
+    request_frame(TRIG_X);
+}
+
+static void bars_init(void) {
+#ifdef XRANDR
+    int err_base;
+    if (XRRQueryExtension(g_dpy, &g_rr_event, &err_base))
+        XRRSelectInput(g_dpy, g_root, RRScreenChangeNotifyMask);
+    else
+        g_rr_event = -1;
+#endif
+    bars_update();
+}
+
+/* ---------------- click regions ---------------- */
+
+static int region_cmp(const void *a, const void *b) {
+    return ((const ClickRegion *)a)->x0 - ((const ClickRegion *)b)->x0;
+}
+
+/* the ^ca() spans of runs drawn at x, as far as they are visible in [lo, hi);
+   neighbouring runs with the same actions share a region. commands are copied,
+   so a click never sees text that changed after the frame it was aimed at */
+static void regions_from_runs(Bar *b, const TextRuns *r, int x, int lo, int hi) {
+    const TextRun *prev = NULL;
+    for (int i = 0; i < r->n; ++i) {
+        const TextRun *run = &r->run[i];
+        int any = 0;
+        for (int k = 0; k < CLICK_BUTTONS; ++k) any |= run->act[k] && run->act_len[k] > 0;
+        int x0 = MAX(x + run->x, lo), x1 = MIN(x + run->x + run->w, hi);
+        if (!any || x0 >= x1) { prev = NULL; continue; }
+        if (prev && memcmp(prev->act, run->act, sizeof(run->act)) == 0 &&
+            memcmp(prev->act_len, run->act_len, sizeof(run->act_len)) == 0) {
+            b->regions[b->regions_n - 1].x1 = x1;
+            continue;
+        }
+        if (b->regions_n == MAX_REGIONS) return;
+        ClickRegion *cr = &b->regions[b->regions_n++];
+        memset(cr, 0, sizeof(*cr));
+        cr->x0 = x0;
+        cr->x1 = x1;
+        for (int k = 0; k < CLICK_BUTTONS; ++k) {
+            size_t n = run->act[k] ? (size_t)run->act_len[k] : 0;
+            if (!n || b->act_len + n + 1 > sizeof(b->act_text)) continue;
+            memcpy(b->act_text + b->act_len, run->act[k], n);
+            b->act_text[b->act_len + n] = '\0';
+            cr->cmd[k] = (unsigned short)(b->act_len + 1);
+            b->act_len += n + 1;
+        }
+        prev = run;
+    }
+}
+
+/* rebuild b's regions after a layout change or a marquee step: tags, then
+   the text actions where the segments are painted */
+static void regions_build(Bar *b) {
+    const Segment *st = &b->segs[SEG_STATUS], *rt = &b->segs[SEG_RIGHT];
+    b->regions_n = 0;
+    b->act_len = 0;
+    for (int i = 0; i < b->tagrects_n; ++i) {
+        ClickRegion *cr = &b->regions[b->regions_n++];
+        memset(cr, 0, sizeof(*cr));
+        cr->x0 = b->tagrects[i].x;
+        cr->x1 = b->tagrects[i].x + b->tagrects[i].w;
+        cr->tag = b->tagrects[i].tag;
+    }
+    if (b->marquee) {
+        for (int x = st->x - b->marquee_off; x < st->x + st->painted_w; x += g_status_runs.w + MARQUEE_GAP)
+            regions_from_runs(b, &g_status_runs, x, st->x, st->x + st->painted_w);
+    } else {
+        regions_from_runs(b, &g_status_runs, st->x, st->x, st->x + st->painted_w);
+    }
+    regions_from_runs(b, &g_right_runs, rt->x, rt->x, rt->x + rt->painted_w);
+    qsort(b->regions, (size_t)b->regions_n, sizeof(b->regions[0]), region_cmp);
+}
+
+/* the region under x: the last one starting at or before x, if it reaches x */
+static const ClickRegion *region_find(const Bar *b, int x) {
+    int lo = 0, hi = b->regions_n - 1, found = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (b->regions[mid].x0 <= x) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found >= 0 && x < b->regions[found].x1 ? &b->regions[found] : NULL;
+}
+
+static void action_switch(const char *arg) {
+    int ws = atoi(arg);
+    if (ws >= 1 && ws <= g_ws_count) do_switch(ws);
+}
+
+/* in-process actions, "@name arg" in ^ca() */
+static const struct { const char *name; void (*fn)(const char *arg); } g_actions[] = {
+    { "switch", action_switch },
+};
+
+/* run a ^ca() command without waiting for it: built-ins are called directly,
+   anything else goes to the background spawner */
+static void action_run(const char *cmd) {
+    if (cmd[0] != '@') {
+        if (spawn_bg(cmd, NULL, NULL) < 0) fprintf(stderr, "click: cannot run %s\n", cmd);
+        return;
+    }
+    size_t nl = strcspn(cmd + 1, " ");
+    for (size_t i = 0; i < sizeof(g_actions) / sizeof(g_actions[0]); ++i) {
+        if (strlen(g_actions[i].name) != nl || strncmp(g_actions[i].name, cmd + 1, nl) != 0) continue;
+        g_actions[i].fn(cmd + 1 + nl + strspn(cmd + 1 + nl, " "));
+        return;
+    }
+    fprintf(stderr, "click: unknown action %s\n", cmd);
+}
+
+/* ---------------- marquee ---------------- */
 
-    g_draw = XftDrawCreate(g_dpy, g_win, vis, g_cmap);
+/* a status too wide for its area scrolls left and wraps around, with
+   MARQUEE_GAP between the end and the next copy */
 
-    set_strut(g_dpy, g_win, g_bar_h);
+/* b's status copies at its scroll offset, painted only where the damage meets
+   the status area; glyphs outside that are not sent at all */
+static void marquee_draw(Bar *b, int text_y) {
+    const Segment *st = &b->segs[SEG_STATUS];
+    int lo = st->x, hi = st->x + st->painted_w;
+    XRectangle clip[MAX_DAMAGE];
+    int n = 0, dlo = hi, dhi = lo;
+    for (int i = 0; i < g_damage_n; ++i) {
+        int x0 = MAX(g_damage[i].x, lo), x1 = MIN(g_damage[i].x + g_damage[i].width, hi);
+        if (x0 >= x1) continue;
+        clip[n].x = (short)x0;
+        clip[n].y = 0;
+        clip[n].width = (unsigned short)(x1 - x0);
+        clip[n].height = (unsigned short)g_bar_h;
+        n++;
+        dlo = MIN(dlo, x0);
+        dhi = MAX(dhi, x1);
+    }
+    if (!n) return;
+    XftDrawSetClipRectangles(b->back_draw, 0, 0, clip, n);
+    for (int x = lo - b->marquee_off; x < dhi; x += g_status_runs.w + MARQUEE_GAP)
+        markup_draw_span(b->back_draw, &g_status_runs, x, text_y, dlo, dhi);
+    XftDrawSetClipRectangles(b->back_draw, 0, 0, g_damage, g_damage_n);
+}
 
-    XMapWindow(g_dpy, g_win);
+/* scroll b's status d pixels: the back buffer shifts in place, only the
+   column that came in is painted, and the status area goes to the window */
+static void marquee_step(Bar *b, int d) {
+    const Segment *st = &b->segs[SEG_STATUS];
+    int x = st->x, w = st->painted_w;
+    b->marquee_off = (b->marquee_off + d) % (g_status_runs.w + MARQUEE_GAP);
+    damage_reset();
+    if (d < w) {
+        XCopyArea(g_dpy, b->back, b->back, g_gc_bg, x + d, 0, w - d, g_bar_h, x, 0);
+        damage_add(b, x + w - d, d);
+    } else {
+        damage_add(b, x, w);
+    }
+    damage_clip(b, 1);
+    XFillRectangle(g_dpy, b->back, g_gc_bg, g_damage[0].x, 0, g_damage[0].width, g_bar_h);
+    marquee_draw(b, g_font->ascent + (g_bar_h - (g_font->ascent + g_font->descent)) / 2);
+    damage_clip(b, 0);
+    XCopyArea(g_dpy, b->back, b->win, g_gc_bg, x, 0, w, g_bar_h, x, 0);
+    regions_build(b);
+}
 
-    /* initial spawn immediately */
-    g_cmd_fd = -1;
-    g_cmd_pid = -1;
-    g_next_spawn = 0;
-    spawn_status_cmd();
+/* one tick per frame interval, at least a pixel per tick */
+static uint64_t marquee_tick(void) {
+    return MAX(g_frame_interval, 1000 / (uint64_t)g_marquee);
+}
+
+static void marquee_due(void *ctx) {
+    (void)ctx;
+    if (!g_marquee) return;
+    uint64_t now = now_ms();
+    int d = (int)((now - g_marquee_last) * (uint64_t)g_marquee / 1000);
+    if (d > 0) {
+        /* keep the remainder, so slow speeds still add up */
+        g_marquee_last += (uint64_t)d * 1000 / (uint64_t)g_marquee;
+        int sent = 0;
+        for (int i = 0; i < g_bars_n; ++i) {
+            Bar *b = &g_bars[i];
+            if (!b->marquee || !b->frame_valid) continue;
+            if (g_frame_pending) {
+                /* the runs may already point at newer text; the pending frame
+                   repaints the status at the new offset */
+                b->marquee_off = (b->marquee_off + d) % (g_status_runs.w + MARQUEE_GAP);
+                b->segs[SEG_STATUS].measured = 0;
+                continue;
+            }
+            marquee_step(b, d);
+            sent = 1;
+        }
+        if (sent) {
+            XFlush(g_dpy);
+            g_marquee_steps++;
+        }
+    }
+    timer_arm(&g_marquee_timer, now + marquee_tick());
+}
+
+/* after a frame: run the timer while any bar scrolls, stop it when none does */
+static void marquee_sync(void) {
+    int any = 0;
+    for (int i = 0; i < g_bars_n; ++i) any |= g_bars[i].marquee;
+    if (!any) {
+        timer_cancel(&g_marquee_timer);
+    } else if (!g_marquee_timer.due) {
+        g_marquee_last = now_ms();
+        timer_arm(&g_marquee_timer, g_marquee_last + marquee_tick());
+    }
+}
+
+/* ---------------- draw_all ---------------- */
+
+/* focused workspace -> a pending switch, else the wm file, else EWMH; all cached outside
+   the render path. without the wm files, follow EWMH (never more tags than desktops) */
+static int current_workspace(int *ws_count_out) {
+    int focused_ws = 1;
+    int ws_count = g_ws_count;
+    if (g_wm_focused > 0) focused_ws = g_wm_focused;
+    else {
+        if (g_ewmh_current > 0) focused_ws = g_ewmh_current;
+        if (g_ewmh_ndesktops > 0 && g_ewmh_ndesktops < ws_count) ws_count = g_ewmh_ndesktops;
+    }
+    if (g_switch_pending) focused_ws = g_switch_pending;
+    if (focused_ws < 1) focused_ws = 1;
+    if (focused_ws > ws_count) focused_ws = ws_count;
+    *ws_count_out = ws_count;
+    return focused_ws;
+}
+
+/* one bar's frame from the shared inputs; returns 1 if anything was sent */
+static int draw_bar(Bar *b, const char *status_text, const char *right_text,
+                    int focused_ws, int ws_count, unsigned int occupied) {
+    /* fingerprint each segment's inputs; a segment is only re-measured and
+       repainted when its fingerprint moved, and nothing happens if none did */
+    int geom[5] = { b->ow, g_bar_h, g_fullscreen, ws_count, b->ox };
+    uint64_t fp_geom = fp_bytes(FP_SEED, geom, sizeof(geom));
+    fp_geom = fp_bytes(fp_geom, &g_font, sizeof(g_font));
+    int tag_in[2] = { focused_ws, (int)occupied };
+    int tags_dirty = segment_check(&b->segs[SEG_TAGS], fp_bytes(fp_geom, tag_in, sizeof(tag_in)));
+    int status_dirty = segment_check(&b->segs[SEG_STATUS],
+                                     fp_bytes(fp_geom, status_text, strlen(status_text)));
+    int right_dirty = segment_check(&b->segs[SEG_RIGHT],
+                                    fp_bytes(fp_geom, right_text, strlen(right_text)));
+    if (b->frame_valid && fp_geom == b->frame_geom && !tags_dirty && !status_dirty && !right_dirty) {
+        g_frames_skipped++;
+        return 0;
+    }
+    g_frames_painted++;
+
+    /* measure tags widths */
+    if (tags_dirty) {
+        int x = PADDING;
+        b->tagrects_n = 0;
+
+        for (int i = 1; i <= ws_count; ++i) {
+            if (!(occupied & (1u << i))) continue;
+
+            int w = g_tag_w[i] + TAG_PADDING;
+
+            if (b->tagrects_n < MAX_WS) {
+                b->tagrects[b->tagrects_n].x = x;
+                b->tagrects[b->tagrects_n].w = w;
+                b->tagrects[b->tagrects_n].tag = i;
+                b->tagrects_n++;
+            }
+            x += w + TAG_SPACING;
+        }
+        b->segs[SEG_TAGS].w = x;
+    }
+
+    /* widths were measured once for all bars, in draw_all */
+    if (status_dirty) b->segs[SEG_STATUS].w = g_status_runs.w;
+    if (right_dirty) b->segs[SEG_RIGHT].w = g_right_runs.w;
+
+    int left_width = b->segs[SEG_TAGS].w;
+    int status_w = b->segs[SEG_STATUS].w;
+    int right_w = b->segs[SEG_RIGHT].w;
+
+    /* compute content width including right area */
+    int content_w = left_width + status_w + right_w + PADDING * 3;
+    if (content_w < 200) content_w = 200;
+    if (content_w > b->ow) content_w = b->ow;
+
+    int win_x = (b->ow - content_w) / 2;
+    if (win_x < 0) win_x = 0;
+
+    if (g_fullscreen) {
+        content_w = b->ow;
+        win_x = 0;
+    }
+
+    /* only configure when the geometry actually changes; no sync, the frame is flushed once below */
+    if (win_x != b->win_x || content_w != b->win_w || g_bar_h != b->win_h) {
+        XMoveResizeWindow(g_dpy, b->win, b->ox + win_x, b->oy, content_w, g_bar_h);
+        b->win_x = win_x;
+        b->win_w = content_w;
+        b->win_h = g_bar_h;
+    }
+
+    /* compute positions:
+       left end     = left_width
+       right start  = content_w - PADDING - right_w
+       status area  = between left_end + PADDING  and  right_start - PADDING
+    */
+    int base_left_end = left_width;
+    int right_start = content_w - PADDING - right_w;
+    if (right_start < base_left_end + PADDING) {
+        right_start = base_left_end + PADDING;
+    }
+
+    int status_area_left = base_left_end + PADDING;
+    int status_area_right = right_start - PADDING;
+    int inner_w = MAX(status_area_right - status_area_left, 0);
+
+    /* fullscreen centers on the whole bar, but never over the tags or the right
+       area; text wider than the space between them is cut or scrolls */
+    int status_x = status_area_left;
+    if (status_w < inner_w) {
+        status_x = g_fullscreen ? (content_w - status_w) / 2 : status_area_left + (inner_w - status_w) / 2;
+        if (status_x < status_area_left) status_x = status_area_left;
+        if (status_x + status_w > status_area_right) status_x = status_area_right - status_w;
+    }
+    int status_vis = MIN(status_w, inner_w);
+    int scroll = g_marquee > 0 && status_w > inner_w && inner_w > 0;
+    if (scroll && !b->marquee) b->marquee_off = 0;
+    if (scroll) b->marquee_off %= status_w + MARQUEE_GAP;
+    if (scroll != b->marquee) status_dirty = 1;
+    b->marquee = scroll;
+
+    int right_draw_x = right_start;
+    if (right_draw_x < 0) right_draw_x = 0;
+
+    /* damage: dirty segments plus segments that moved; only that gets repainted and copied */
+    backbuf_ensure(b);
+    damage_reset();
+    Segment *st = &b->segs[SEG_STATUS], *rt = &b->segs[SEG_RIGHT], *tg = &b->segs[SEG_TAGS];
+    if (!b->frame_valid || b->frame_geom != fp_geom || b->frame_w != content_w) {
+        damage_add(b, 0, content_w);
+    } else {
+        if (tags_dirty) damage_add(b, 0, MAX(tg->painted_w, left_width));
+        if (status_dirty || st->x != status_x || st->painted_w != status_vis) {
+            damage_add(b, st->x - 2, st->painted_w + 4);
+            damage_add(b, status_x - 2, status_vis + 4);
+        }
+        if (right_dirty || rt->x != right_draw_x) {
+            damage_add(b, rt->x - 2, rt->painted_w + 4);
+            damage_add(b, right_draw_x - 2, right_w + 4);
+        }
+    }
+
+    b->frame_valid = 1;
+    b->frame_geom = fp_geom;
+    b->frame_w = content_w;
+    tg->x = 0;
+    tg->painted_w = left_width;
+    st->x = status_x;
+    st->painted_w = status_vis;
+    rt->x = right_draw_x;
+    rt->painted_w = right_w;
+    regions_build(b);
+
+    if (g_damage_n == 0) return 1;
+
+    /* repaint the damaged spans of the back buffer, clipped to them */
+    uint64_t t = now_us();
+    damage_clip(b, 1);
+    for (int i = 0; i < g_damage_n; ++i)
+        XFillRectangle(g_dpy, b->back, g_gc_bg, g_damage[i].x, 0, g_damage[i].width, g_bar_h);
+
+    int text_y = g_font->ascent + (g_bar_h - (g_font->ascent + g_font->descent)) / 2;
+    for (int i = 0; i < b->tagrects_n; ++i) {
+        int tag = b->tagrects[i].tag;
+        int tx = b->tagrects[i].x;
+        int w = b->tagrects[i].w;
+        if (!damage_hits(tx - 2, w + 4)) continue;
+        char tb[12];
+        snprintf(tb, sizeof(tb), "%d", tag);
+
+        if (tag == focused_ws) {
+            int ry = (g_bar_h - (g_font->ascent + g_font->descent)) / 2 - 2;
+            if (ry < 0) ry = 0;
+            XFillRectangle(g_dpy, b->back, g_gc_focus, tx - 2, ry, w + 4,
+                          g_font->ascent + g_font->descent + 4);
+            text_draw(b->back_draw, &g_xft_focus_text, g_font,
+                      tx + TAG_PADDING / 2, text_y, tb, strlen(tb));
+        } else {
+            text_draw(b->back_draw, &g_xft_fg, g_font,
+                      tx + TAG_PADDING / 2, text_y, tb, strlen(tb));
+        }
+    }
+
+    if (status_text[0] && status_vis > 0 && damage_hits(status_x - 2, status_vis + 4)) {
+        if (scroll) marquee_draw(b, text_y);
+        else markup_draw(b->back_draw, &g_status_runs, status_x, text_y, status_vis);
+    }
+
+    if (right_text[0] && damage_hits(right_draw_x - 2, right_w + 4))
+        markup_draw(b->back_draw, &g_right_runs, right_draw_x, text_y, right_w);
+    damage_clip(b, 0);
+
+    /* present: copy only the damaged spans to the window */
+    for (int i = 0; i < g_damage_n; ++i)
+        XCopyArea(g_dpy, b->back, b->win, g_gc_bg, g_damage[i].x, 0, g_damage[i].width, g_bar_h,
+                  g_damage[i].x, 0);
+    g_phase_us[PH_XDRAW] += now_us() - t;
+    return 1;
+}
+
+static void draw_all(void) {
+    if (!g_dpy || !g_font) return; /* until the font is in, the window background is the frame */
+    uint64_t t0 = now_us();
+    memset(g_phase_us, 0, sizeof(g_phase_us));
 
+    /* use the latest line we have from the spawned command */
+    const char *status_text = g_status_line;
+
+    /* build right text from the cached right cmd outputs, joined with two spaces.
+       static: the right runs point into it across frames */
+    static char right_text[MAX_TEXT];
+    right_text[0] = '\0';
+    for (int i = 0; i < g_right_cmds_n; ++i)
+        if (g_right_cmds[i].out[0]) right_append(right_text, sizeof(right_text), g_right_cmds[i].out, 1);
+    for (int i = 0; i < MAX_IPC_SEGS; ++i)
+        if (g_ipc_segs[i].name[0]) right_append(right_text, sizeof(right_text), g_ipc_segs[i].text, 0);
+    shm_poll();
+    for (int i = 0; g_shm && i < HSDBAR_SHM_SEGS; ++i) {
+        if (!g_shm_text[i][0] || atomic_load(&g_shm->seg[i].state) != 1) continue;
+        right_append(right_text, sizeof(right_text), g_shm_text[i], 0);
+    }
+
+    /* markup and widths once for every bar; unchanged text costs a fingerprint */
+    uint64_t tm = now_us();
+    markup_layout(&g_status_runs, status_text);
+    markup_layout(&g_right_runs, right_text);
+    g_phase_us[PH_MEASURE] += now_us() - tm;
+
+    int ws_count;
+    int focused_ws = current_workspace(&ws_count);
+
+    /* bit i set = workspace i occupied */
+    unsigned int occupied = g_wm_occupied_valid ? g_wm_occupied : ewmh_occupied();
+    occupied &= (2u << ws_count) - 2;
+    occupied |= 1u << focused_ws;
+
+    /* inputs are gathered once, every output's bar is drawn from them */
+    int sent = 0;
+    for (int i = 0; i < g_bars_n; ++i)
+        sent |= draw_bar(&g_bars[i], status_text, right_text, focused_ws, ws_count, occupied);
+    marquee_sync();
+
+    /* the whole frame goes out in one flush */
+    uint64_t t = now_us();
+    if (sent) XFlush(g_dpy);
+    frame_done();
+    uint64_t end = now_us();
+    g_phase_us[PH_FLUSH] = end - t;
+
+    /* layout is whatever the other phases did not account for */
+    uint64_t total = end - t0, other = g_phase_us[PH_MEASURE] + g_phase_us[PH_XDRAW] + g_phase_us[PH_FLUSH];
+    g_phase_us[PH_LAYOUT] = total > other ? total - other : 0;
+    for (int i = 0; i < PH_COUNT; ++i) hist_add(&g_hist_phase[i], g_phase_us[i]);
+    hist_add(&g_hist_draw, total);
+}
+
+/* ---------------- frame pacing ---------------- */
+
+/* render now, whatever the cap says (startup, clicks) */
+static void render_frame(int src) {
+    if (src != TRIG_NONE) g_triggers[src]++;
+    g_frame_pending = 0;
+    timer_cancel(&g_frame_timer);
+    g_last_frame = now_ms();
+    g_updates_rendered++;
     draw_all();
+}
+
+/* inputs call this instead of draw_all(); the frame is rendered once the
+   current wakeup is fully drained, and never faster than HARD_MAX_FPS */
+static void request_frame(int src) {
+    g_triggers[src]++;
+    if (!g_frame_pending) {
+        g_frame_pending = 1;
+        return;
+    }
+    if (g_frame_timer.due) g_updates_dropped++;
+    else g_updates_coalesced++;
+}
+
+static void frame_due(void *ctx) {
+    (void)ctx;
+    if (g_frame_pending) render_frame(TRIG_NONE);
+}
+
+/* end of a wakeup: render the pending frame or hold it until the interval passed */
+static void frame_flush(void) {
+    if (!g_frame_pending || g_frame_timer.due) return;
+    uint64_t next = g_last_frame + g_frame_interval;
+    if (now_ms() >= next) render_frame(TRIG_NONE);
+    else timer_arm(&g_frame_timer, next);
+}
+
+/* ---------------- config ---------------- */
+
+/* string keys copy into the field, len 0 marks an int */
+static const struct { const char *key; size_t off, len; } g_cfg_keys[] = {
+    { "font",       offsetof(Config, font),       sizeof(((Config*)0)->font) },
+    { "bg",         offsetof(Config, bg),         sizeof(((Config*)0)->bg) },
+    { "fg",         offsetof(Config, fg),         sizeof(((Config*)0)->fg) },
+    { "focus_bg",   offsetof(Config, focus_bg),   sizeof(((Config*)0)->focus_bg) },
+    { "status",     offsetof(Config, status),     sizeof(((Config*)0)->status) },
+    { "switch_cmd", offsetof(Config, switch_cmd), sizeof(((Config*)0)->switch_cmd) },
+    { "interval",   offsetof(Config, interval),   0 },
+    { "max_fps",    offsetof(Config, max_fps),    0 },
+    { "bar_height", offsetof(Config, bar_height), 0 },
+    { "workspaces", offsetof(Config, workspaces), 0 },
+    { "fullscreen", offsetof(Config, fullscreen), 0 },
+    { "marquee",    offsetof(Config, marquee),    0 },
+};
 
-    /* main loop - rebuild pollfds each iteration so we include cmd fd when present */
-    char inbuf[1024] __attribute__((aligned(__alignof__(struct inotify_event))));
-    int status_interval = HARD_INTERVAL;
-    if (status_interval <= 0) status_interval = 1;
-
-    while (1) {
-        /* rebuild pollfds */
-        struct pollfd pfds[4];
-        int nfds = 0;
-        pfds[nfds].fd = ConnectionNumber(g_dpy);
-        pfds[nfds].events = POLLIN;
-        nfds++;
-
-        if (inofd >= 0) {
-            pfds[nfds].fd = inofd;
-            pfds[nfds].events = POLLIN;
-            nfds++;
-        }
-
-        if (g_cmd_fd >= 0) {
-            pfds[nfds].fd = g_cmd_fd;
-            pfds[nfds].events = POLLIN;
-            nfds++;
-        }
-
-        /* compute timeout: small tick to let X events be responsive */
-        int timeout = 200; /* ms */
-        /* if there's no running cmd, but next_spawn is in the past, spawn immediately */
-        time_t now = time(NULL);
-        if (g_cmd_fd < 0 && (g_next_spawn == 0 || now >= g_next_spawn)) {
-            spawn_status_cmd();
-            /* after spawn, redraw immediately */
-            draw_all();
+static void config_defaults(Config *c) {
+    memset(c, 0, sizeof(*c));
+    snprintf(c->font, sizeof(c->font), "%s", HARD_FONT);
+    snprintf(c->bg, sizeof(c->bg), "%s", HARD_BG);
+    snprintf(c->fg, sizeof(c->fg), "%s", HARD_FG);
+    snprintf(c->focus_bg, sizeof(c->focus_bg), "%s", HARD_FOCUS_BG);
+    snprintf(c->status, sizeof(c->status), "%s", HARD_CMD);
+    c->interval = HARD_INTERVAL;
+    c->max_fps = HARD_MAX_FPS;
+    c->bar_height = HARD_BAR_HEIGHT;
+    c->workspaces = HARD_WS_COUNT;
+    c->fullscreen = HARD_FULLSCREEN;
+    c->marquee = HARD_MARQUEE;
+    for (int i = 0; i < RIGHT_CMD_COUNT && c->right_n < MAX_RIGHT_CMDS; ++i) {
+        if (!RIGHT_CMDS[i].cmd || !RIGHT_CMDS[i].cmd[0]) continue;
+        RightCmdConf *r = &c->right[c->right_n++];
+        snprintf(r->cmd, sizeof(r->cmd), "%s", RIGHT_CMDS[i].cmd);
+        r->interval = RIGHT_CMDS[i].interval;
+    }
+}
+
+static char *config_trim(char *s) {
+    while (isspace((unsigned char)*s)) ++s;
+    size_t n = strlen(s);
+    while (n && isspace((unsigned char)s[n - 1])) s[--n] = '\0';
+    return s;
+}
+
+/* "key = value" per line, '#' starts a comment line:
+     font bg fg focus_bg status switch_cmd              strings, as the HARD_* defaults
+     interval max_fps bar_height workspaces fullscreen  integers
+     marquee                                            px/s, 0 = cut long status text
+     right = [SECONDS] CMD                              in order; the first one replaces
+                                                        RIGHT_CMDS, an empty one clears it
+   bad lines are reported and skipped. returns 0 if the file cannot be read */
+static int config_parse(Config *c, const char *path) {
+    FILE *f = path[0] ? fopen(path, "re") : NULL;
+    if (!f) return 0;
+    char line[1024];
+    int lineno = 0, right_seen = 0;
+    while (fgets(line, sizeof(line), f)) {
+        ++lineno;
+        char *k = config_trim(line);
+        if (!*k || *k == '#') continue;
+        char *eq = strchr(k, '=');
+        if (!eq) {
+            fprintf(stderr, "%s:%d: expected key = value\n", path, lineno);
             continue;
         }
+        *eq = '\0';
+        char *v = config_trim(eq + 1);
+        k = config_trim(k);
 
-        int ret = poll(pfds, nfds, timeout);
-
-        if (ret > 0) {
-            /* handle X events first */
-            if (pfds[0].revents & POLLIN) {
-                while (XPending(g_dpy)) {
-                    XEvent ev;
-                    XNextEvent(g_dpy, &ev);
-                    if (ev.type == ButtonPress) {
-                        int cx = ev.xbutton.x;
-                        for (int i = 0; i < g_tagrects_n; ++i) {
-                            if (cx >= g_tagrects[i].x && cx < g_tagrects[i].x + g_tagrects[i].w) {
-                                do_switch(g_tagrects[i].tag);
-                                draw_all();
-                                break;
-                            }
-                        }
-                    } else if (ev.type == ConfigureNotify) {
-                        g_screen_w = DisplayWidth(g_dpy, g_scr);
-                        draw_all();
-                    }
-                }
+        if (strcmp(k, "right") == 0) {
+            if (!right_seen++) c->right_n = 0;
+            if (!*v || c->right_n == MAX_RIGHT_CMDS) continue;
+            RightCmdConf *r = &c->right[c->right_n];
+            char *end;
+            long iv = strtol(v, &end, 10);
+            r->interval = 0;
+            if (end != v && isspace((unsigned char)*end)) {
+                r->interval = (int)iv;
+                v = config_trim(end);
             }
+            snprintf(r->cmd, sizeof(r->cmd), "%s", v);
+            c->right_n++;
+            continue;
+        }
 
-            /* handle inotify if present */
-            int idx = 1;
-            if (inofd < 0) idx = 1; /* skip */
-            if (inofd >= 0) {
-                if (pfds[1].revents & POLLIN) {
-                    ssize_t len = read(inofd, inbuf, sizeof(inbuf));
-                    (void)len;
-                    draw_all();
-                }
-                idx = 2;
-            }
+        size_t i = 0, n = sizeof(g_cfg_keys) / sizeof(g_cfg_keys[0]);
+        while (i < n && strcmp(k, g_cfg_keys[i].key) != 0) ++i;
+        if (i == n) {
+            fprintf(stderr, "%s:%d: unknown key %s\n", path, lineno, k);
+            continue;
+        }
+        char *field = (char *)c + g_cfg_keys[i].off;
+        if (g_cfg_keys[i].len) {
+            snprintf(field, g_cfg_keys[i].len, "%s", v);
+        } else {
+            char *end;
+            long iv = strtol(v, &end, 10);
+            if (end == v || *end) fprintf(stderr, "%s:%d: %s: not a number\n", path, lineno, k);
+            else *(int *)field = (int)iv;
+        }
+    }
+    fclose(f);
+    return 1;
+}
 
-            /* handle cmd fd - it will be at pfds[idx] if present */
-            if (g_cmd_fd >= 0) {
-                int cmd_pfd_index = nfds - 1; /* it was appended last */
-                if (pfds[cmd_pfd_index].revents & (POLLIN | POLLHUP | POLLERR)) {
-                    char buf[1024];
-                    ssize_t r = read(g_cmd_fd, buf, sizeof(buf));
-                    if (r > 0) {
-                        process_cmd_bytes(buf, r);
-                        draw_all();
-                    } else if (r == 0) {
-                        /* EOF - command exited */
-                        stop_status_cmd_and_schedule_restart(status_interval);
-                        draw_all();
-                    } else {
-                        if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                            /* error - close and schedule restart */
-                            stop_status_cmd_and_schedule_restart(status_interval);
-                            draw_all();
-                        }
-                    }
-                }
-            }
-        } else if (ret == 0) {
-            /* timeout */
-            /* if command isn't running we may need to spawn after next_spawn */
-            time_t now2 = time(NULL);
-            if (g_cmd_fd < 0 && g_next_spawn != 0 && now2 >= g_next_spawn) {
-                spawn_status_cmd();
-                draw_all();
-            }
-            /* otherwise nothing to do; periodic redraw handled below */
+/* clamp what the file may have gotten wrong; --status-cmd wins over the file */
+static void config_finish(Config *c) {
+    if (c->interval <= 0) c->interval = 1;
+    if (c->max_fps <= 0) c->max_fps = HARD_MAX_FPS;
+    if (c->max_fps > 1000) c->max_fps = 1000;
+    if (c->bar_height <= 0) c->bar_height = 28;
+    if (c->workspaces <= 0) c->workspaces = 1;
+    if (c->workspaces > MAX_WS) c->workspaces = MAX_WS;
+    c->fullscreen = c->fullscreen != 0;
+    if (c->marquee < 0) c->marquee = 0;
+    if (c->marquee > 1000) c->marquee = 1000;
+    if (g_status_override) snprintf(c->status, sizeof(c->status), "%s", g_status_override);
+}
+
+/* $XDG_CONFIG_HOME/hsdbar/config, else ~/.config/hsdbar/config */
+static void config_init(void) {
+    const char *xdg = getenv("XDG_CONFIG_HOME"), *home = getenv("HOME");
+    if (xdg && xdg[0]) snprintf(g_cfg_dir, sizeof(g_cfg_dir), "%s/hsdbar", xdg);
+    else if (home) snprintf(g_cfg_dir, sizeof(g_cfg_dir), "%s/.config/hsdbar", home);
+    if (g_cfg_dir[0]) snprintf(g_cfg_path, sizeof(g_cfg_path), "%s/config", g_cfg_dir);
+    config_defaults(&g_cfg);
+    config_parse(&g_cfg, g_cfg_path);
+    config_finish(&g_cfg);
+}
+
+/* watch the config directory on the wm inotify fd, so editors that save by
+   rename are seen too. if it does not exist yet, watch its parent for it to
+   appear, like ~/.wm */
+static void config_watch(void) {
+    if (g_ino_fd < 0 || !g_cfg_dir[0]) return;
+    g_cfg_wd = inotify_add_watch(g_ino_fd, g_cfg_dir,
+                                 IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM |
+                                 IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+    if (g_cfg_wd >= 0 || g_cfg_parent_wd >= 0) return;
+    char parent[PATH_MAX];
+    snprintf(parent, sizeof(parent), "%s", g_cfg_dir);
+    char *slash = strrchr(parent, '/');
+    if (!slash || slash == parent) return;
+    *slash = '\0';
+    g_cfg_parent_wd = inotify_add_watch(g_ino_fd, parent, IN_CREATE | IN_MOVED_TO | IN_ONLYDIR);
+}
+
+/* kill rc's run if any and empty the slot; its timer stays registered */
+static void right_cmd_stop(RightCmd *rc) {
+    timer_cancel(&rc->timer);
+    if (rc->watch) io_del(rc->watch);
+    rc->watch = NULL;
+    if (rc->fd >= 0) close(rc->fd);
+    rc->fd = -1;
+    if (rc->pid > 0) {
+        kill(rc->pid, SIGTERM);
+        bg_adopt(rc->pid);
+    }
+    rc->pid = -1;
+    if (rc->mod) module_free(rc->mod);
+    rc->mod = NULL;
+    free(rc->cmd);
+    rc->cmd = NULL;
+    rc->len = 0;
+    rc->out[0] = '\0';
+}
+
+/* every slot gets its timer once, so reloads never register more */
+static void right_cmds_init(void) {
+    for (int i = 0; i < MAX_RIGHT_CMDS; ++i) {
+        RightCmd *rc = &g_right_cmds[i];
+        memset(rc, 0, sizeof(*rc));
+        rc->pid = -1;
+        rc->fd = -1;
+        timer_init(&rc->timer, right_cmd_due, rc);
+    }
+}
+
+/* make g_right_cmds match g_cfg.right slot by slot: an unchanged command keeps
+   running with its cached output, the rest is stopped and started fresh.
+   returns 1 if anything changed */
+static int right_cmds_apply(void) {
+    int n = 0, changed = 0;
+    for (int i = 0; i < g_cfg.right_n; ++i) {
+        const RightCmdConf *cf = &g_cfg.right[i];
+        RightCmd *rc = &g_right_cmds[n];
+        if (n < g_right_cmds_n && rc->cmd && strcmp(rc->cmd, cf->cmd) == 0 && rc->interval == cf->interval) {
+            n++;
+            continue;
+        }
+        Module *mod = NULL;
+        /* unknown or unavailable here (e.g. no battery): drop it, the slot stays */
+        if (cf->cmd[0] == '@' && !(mod = module_new(cf->cmd, cf->interval))) continue;
+        right_cmd_stop(rc);
+        changed = 1;
+        rc->cmd = strdup(cf->cmd);
+        rc->mod = mod;
+        rc->interval = cf->interval;
+        timer_arm(&rc->timer, now_ms()); /* due immediately */
+        n++;
+    }
+    for (int i = n; i < g_right_cmds_n; ++i) {
+        right_cmd_stop(&g_right_cmds[i]);
+        changed = 1;
+    }
+    g_right_cmds_n = n;
+    return changed;
+}
+
+/* (re)start the status producer from g_cfg; a running command's group is stopped first */
+static void status_apply(void) {
+    stop_status_cmd_and_schedule_restart(g_status_interval);
+    timer_cancel(&g_status_timer);
+    if (g_status_mod) module_free(g_status_mod);
+    g_status_mod = NULL;
+    g_status_interval = g_cfg.interval;
+    g_cmd = g_cfg.status[0] ? g_cfg.status : NULL;
+    if (g_cmd && g_cmd[0] == '@' && !(g_status_mod = module_new(g_cmd, 0)))
+        g_cmd = NULL;
+    g_cmd_backoff = 0;
+    g_status_line[0] = '\0';
+    if (!spawn_status_cmd())
+        timer_arm(&g_status_timer, now_ms() + (uint64_t)g_status_interval * 1000);
+}
+
+/* the config file changed: re-read it and apply only the difference. the display,
+   GCs, bar windows and back buffers stay; the font, colors and children are only
+   replaced when their own settings changed */
+static void config_reload(void) {
+    static Config old;
+    uint64_t t0 = now_us();
+    old = g_cfg;
+    config_defaults(&g_cfg);
+    config_parse(&g_cfg, g_cfg_path);
+    config_finish(&g_cfg);
+
+    char what[160] = "";
+    size_t wn = 0;
+    int repaint = 0;
+#define CFG_NOTE(s) (wn += (size_t)snprintf(what + wn, sizeof(what) - wn, " %s", s))
+
+    if (g_font && strcmp(old.font, g_cfg.font) != 0) { /* a pending load picks up g_cfg.font */
+        XftFont *f = font_open(g_cfg.font);
+        if (f) {
+            text_cache_clear();
+            XftFontClose(g_dpy, g_font);
+            g_font = f;
+            tag_widths_init();
+            repaint = 1;
+            CFG_NOTE("font");
         } else {
+            fprintf(stderr, "config: cannot open font %s, keeping the old one\n", g_cfg.font);
+            memcpy(g_cfg.font, old.font, sizeof(g_cfg.font));
+        }
+    }
+    if (strcmp(old.bg, g_cfg.bg) != 0) {
+        color_bg_set(g_cfg.bg);
+        XSetForeground(g_dpy, g_gc_bg, g_bg_pixel);
+        for (int i = 0; i < g_bars_n; ++i) XSetWindowBackground(g_dpy, g_bars[i].win, g_bg_pixel);
+        repaint = 1;
+        CFG_NOTE("bg");
+    }
+    if (strcmp(old.fg, g_cfg.fg) != 0) {
+        color_fg_set(g_cfg.fg, 1);
+        repaint = 1;
+        CFG_NOTE("fg");
+    }
+    if (strcmp(old.focus_bg, g_cfg.focus_bg) != 0) {
+        color_focus_set(g_cfg.focus_bg, 1);
+        XSetForeground(g_dpy, g_gc_focus, g_xc_focus.pixel);
+        repaint = 1;
+        CFG_NOTE("focus_bg");
+    }
+    if (old.bar_height != g_cfg.bar_height) {
+        g_bar_h = g_cfg.bar_height;
+        for (int i = 0; i < g_bars_n; ++i) {
+            Bar *b = &g_bars[i];
+            set_strut(g_dpy, b->win, b->oy + g_bar_h, b->ox, b->ox + b->ow - 1);
+        }
+        CFG_NOTE("bar_height");
+    }
+    if (old.workspaces != g_cfg.workspaces || old.fullscreen != g_cfg.fullscreen) {
+        g_ws_count = g_cfg.workspaces;
+        g_fullscreen = g_cfg.fullscreen;
+        CFG_NOTE("layout");
+    }
+    if (old.max_fps != g_cfg.max_fps) {
+        g_frame_interval = 1000 / (uint64_t)g_cfg.max_fps;
+        CFG_NOTE("max_fps");
+    }
+    if (old.marquee != g_cfg.marquee) {
+        g_marquee = g_cfg.marquee;
+        timer_cancel(&g_marquee_timer); /* the next frame restarts it at the new speed */
+        for (int i = 0; i < g_bars_n; ++i) g_bars[i].segs[SEG_STATUS].measured = 0;
+        CFG_NOTE("marquee");
+    }
+    if (strcmp(old.switch_cmd, g_cfg.switch_cmd) != 0) CFG_NOTE("switch_cmd");
+    g_switch_fmt = g_cfg.switch_cmd[0] ? g_cfg.switch_cmd : NULL;
+    if (strcmp(old.status, g_cfg.status) != 0 || old.interval != g_cfg.interval) {
+        status_apply();
+        CFG_NOTE("status");
+    }
+    if (right_cmds_apply()) CFG_NOTE("right");
+#undef CFG_NOTE
+
+    if (repaint)
+        for (int i = 0; i < g_bars_n; ++i) g_bars[i].frame_valid = 0;
+    if (wn) request_frame(TRIG_INOTIFY);
+    fprintf(stderr, "config: reloaded in %.2f ms, changed:%s\n",
+            (double)(now_us() - t0) / 1000.0, wn ? what : " nothing");
+}
+
+/* ---------------- font loading ---------------- */
+
+/* the first FcInit loads (or, cold, rebuilds) every font cache and is the slowest
+   step of startup. it runs here while the bars are mapped with their background.
+   Xlib is not set up for threads, so the worker only touches fontconfig; the Xft
+   open happens on the main thread once the caches are warm */
+static void *font_worker(void *arg) {
+    char *name = arg;
+    uint64_t t0 = now_us();
+    FcInit();
+    FcPattern *pat = FcNameParse((const FcChar8 *)name);
+    if (pat) {
+        FcResult r;
+        FcConfigSubstitute(NULL, pat, FcMatchPattern);
+        FcDefaultSubstitute(pat);
+        FcPattern *match = FcFontMatch(NULL, pat, &r);
+        if (match) FcPatternDestroy(match);
+        FcPatternDestroy(pat);
+    }
+    free(name);
+    g_font_worker_us = now_us() - t0;
+    uint64_t one = 1;
+    if (write(g_font_efd, &one, sizeof(one)) < 0) { /* main thread polls nothing else */ }
+    return NULL;
+}
+
+/* open g_cfg.font and draw the first real frame */
+static void font_ready(void) {
+    g_font = font_open(g_cfg.font);
+    if (!g_font) {
+        fprintf(stderr, "failed to open Xft font; try installing fonts or set font in the config\n");
+        g_running = 0;
+        return;
+    }
+    tag_widths_init();
+    startup_mark("font open");
+    render_frame(TRIG_NONE);
+    if (g_profile_startup) {
+        XSync(g_dpy, False);
+        startup_mark("first frame");
+        fprintf(stderr, "startup %-16s %8.2f ms  (fontconfig init on the worker)\n", "font worker",
+                (double)g_font_worker_us / 1000.0);
+        g_running = 0;
+    }
+}
+
+static void font_worker_io(void *ctx, unsigned int events) {
+    (void)events;
+    IoWatch **w = ctx;
+    uint64_t n;
+    if (read(g_font_efd, &n, sizeof(n)) < 0 && errno == EAGAIN) return;
+    pthread_join(g_font_thread, NULL);
+    io_del(*w);
+    close(g_font_efd);
+    g_font_efd = -1;
+    font_ready();
+}
+
+/* start resolving the font; without a worker it is done right here */
+static void font_load_start(void) {
+    static IoWatch *watch;
+    char *name = strdup(g_cfg.font);
+    g_font_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (name && g_font_efd >= 0 && (watch = io_add(g_font_efd, font_worker_io, &watch))) {
+        if (pthread_create(&g_font_thread, NULL, font_worker, name) == 0) return;
+        io_del(watch);
+    }
+    free(name);
+    if (g_font_efd >= 0) close(g_font_efd);
+    g_font_efd = -1;
+    font_ready();
+}
+
+/* ---------------- event handlers ---------------- */
+
+static void handle_xevent(XEvent *ev) {
+    Bar *b;
+    if (ev->type == ButtonPress) {
+        if (!(b = bar_find(ev->xbutton.window))) return;
+        g_input_time = ev->xbutton.time;
+        int cx = ev->xbutton.x;
+        unsigned int button = ev->xbutton.button;
+        const ClickRegion *cr = region_find(b, cx);
+        if (cr && button >= 1 && button <= CLICK_BUTTONS && cr->cmd[button - 1]) {
+            action_run(b->act_text + cr->cmd[button - 1] - 1);
+            render_frame(TRIG_X); /* a built-in may have changed what is shown */
+            return;
+        }
+        if (button == Button4 || button == Button5) {
+            /* wheel: previous / next workspace, wrapping */
+            int ws_count;
+            int ws = current_workspace(&ws_count);
+            ws += ev->xbutton.button == Button5 ? 1 : -1;
+            if (ws < 1) ws = ws_count;
+            if (ws > ws_count) ws = 1;
+            do_switch(ws);
+            render_frame(TRIG_X);
+            return;
+        }
+        if (cr && cr->tag) {
+            do_switch(cr->tag);
+            render_frame(TRIG_X); /* user input skips the redraw cap */
+        }
+    } else if (ev->type == PropertyNotify) {
+        if (ewmh_property(&ev->xproperty)) request_frame(TRIG_X);
+    } else if (ev->type == Expose) {
+        if ((b = bar_find(ev->xexpose.window)))
+            backbuf_expose(b, ev->xexpose.x, ev->xexpose.y,
+                           ev->xexpose.width, ev->xexpose.height);
+    } else if (ev->type == ConfigureNotify) {
+        /* a root resize without XRandR: the single bar follows the screen */
+        if (ev->xconfigure.window == g_root && g_rr_event < 0) bars_update();
+#ifdef XRANDR
+    } else if (g_rr_event >= 0 && ev->type == g_rr_event + RRScreenChangeNotify) {
+        XRRUpdateConfiguration(ev);
+        bars_update();
+#endif
+    }
+}
+
+static void x_io(void *ctx, unsigned int events) {
+    (void)ctx; (void)events;
+    while (XPending(g_dpy)) {
+        XEvent ev;
+        XNextEvent(g_dpy, &ev);
+        handle_xevent(&ev);
+    }
+}
+
+static void wm_io(void *ctx, unsigned int events) {
+    (void)ctx; (void)events;
+    if (wm_inotify_handle()) request_frame(TRIG_INOTIFY);
+}
+
+/* ---------------- spawn benchmark ---------------- */
+
+/* the spawn path this bar used to have: fork, close fds one by one, exec */
+static pid_t bench_fork(char **argv) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_RDWR);
+        if (devnull >= 0) { dup2(devnull, STDIN_FILENO); dup2(devnull, STDOUT_FILENO); }
+        for (int fd = 3; fd < 256; ++fd) close(fd);
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    return pid;
+}
+
+static double bench_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* --bench-spawn N: time N spawn+wait rounds of fork+exec and posix_spawn on the
+   same argv, once direct and once through sh -c, so the spawn method and the
+   shell show up separately. runs at this process's own RSS, printed first */
+static int bench_spawn(int n) {
+    static char *direct[] = { "true", NULL };
+    static char *shell[] = { "/bin/sh", "-c", "true", NULL };
+    static char **cmds[] = { direct, shell };
+    static const char *names[] = { "true", "sh -c true" };
+    long rss_kb = 0;
+    FILE *sm = fopen("/proc/self/statm", "re");
+    if (sm) {
+        long pages;
+        if (fscanf(sm, "%*s %ld", &pages) == 1) rss_kb = pages * (sysconf(_SC_PAGESIZE) / 1024);
+        fclose(sm);
+    }
+    printf("rss %ld kB\n", rss_kb);
+    printf("%-14s %-10s %10s %12s %12s\n", "cmd", "path", "us/spawn", "minflt/self", "minflt/child");
+    for (size_t c = 0; c < sizeof(cmds) / sizeof(cmds[0]); ++c) {
+        for (int path = 0; path < 2; ++path) {
+            struct rusage s0, c0, s1, c1;
+            getrusage(RUSAGE_SELF, &s0);
+            getrusage(RUSAGE_CHILDREN, &c0);
+            double t0 = bench_ns();
+            for (int i = 0; i < n; ++i) {
+                pid_t pid = path ? spawn_argv(cmds[c], -1, -1, 0) : bench_fork(cmds[c]);
+                if (pid > 0) waitpid(pid, NULL, 0);
+            }
+            double t1 = bench_ns();
+            getrusage(RUSAGE_SELF, &s1);
+            getrusage(RUSAGE_CHILDREN, &c1);
+            printf("%-14s %-10s %10.1f %12.1f %12.1f\n", names[c], path ? "spawn" : "fork",
+                   (t1 - t0) / n / 1e3,
+                   (double)(s1.ru_minflt - s0.ru_minflt) / n,
+                   (double)(c1.ru_minflt - c0.ru_minflt) / n);
+        }
+    }
+    return 0;
+}
+
+/* ---------------- main ---------------- */
+int main(int argc, char **argv) {
+    if (argc == 3 && strcmp(argv[1], "--bench-spawn") == 0)
+        return bench_spawn(atoi(argv[2]) > 0 ? atoi(argv[2]) : 1);
+    if (argc >= 3 && strcmp(argv[1], "--send") == 0)
+        return ipc_send(argc - 2, argv + 2);
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--profile-startup") == 0) g_profile_startup = 1;
+        else if (i + 1 < argc && strcmp(argv[i], "--status-cmd") == 0) g_status_override = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--stats") == 0) g_stats_path = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--status-cmd CMD] [--stats FILE] [--profile-startup]\n", argv[0]);
+            return 1;
+        }
+    }
+    g_start_ms = now_ms();
+    g_prof_start = g_prof_last = now_us();
+    if (!reactor_init()) { perror("reactor"); return 1; }
+    timer_init(&g_status_timer, status_due, NULL);
+    timer_init(&g_cmd_doomed_timer, status_group_due, NULL);
+    timer_init(&g_frame_timer, frame_due, NULL);
+    timer_init(&g_switch_timer, switch_timeout, NULL);
+    timer_init(&g_marquee_timer, marquee_due, NULL);
+
+    config_init();
+    g_switch_fmt = g_cfg.switch_cmd[0] ? g_cfg.switch_cmd : NULL;
+    g_ws_count = g_cfg.workspaces;
+    g_fullscreen = g_cfg.fullscreen;
+    g_frame_interval = 1000 / (uint64_t)g_cfg.max_fps;
+    g_marquee = g_cfg.marquee;
+
+    /* right cmds from the config (RIGHT_CMDS unless it has right = lines) */
+    right_cmds_init();
+    right_cmds_apply();
+    startup_mark("config");
+
+    const char *home = getenv("HOME");
+    if (home) {
+        snprintf(g_home_path, sizeof(g_home_path), "%s", home);
+        snprintf(g_wm_dir, sizeof(g_wm_dir), "%s/.wm", home);
+    }
+    wm_watch_init();
+    config_watch();
+    if (g_ino_fd >= 0) io_add(g_ino_fd, wm_io, NULL);
+    ipc_init();
+    shm_init();
+    startup_mark("watches, ipc");
+
+    g_dpy = XOpenDisplay(NULL);
+    if (!g_dpy) { fprintf(stderr, "cannot open display\n"); return 1; }
+    XSetErrorHandler(xerror);
+    g_scr = DefaultScreen(g_dpy);
+    g_root = RootWindow(g_dpy, g_scr);
+    atoms_init();
+    g_cmap = DefaultColormap(g_dpy, g_scr);
+    g_bar_h = g_cfg.bar_height;
+    startup_mark("display, atoms");
+
+    /* all colors in one pass, background first: a foreground that does not parse
+       contrasts with it. on TrueColor none of this waits for the server */
+    color_bg_set(g_cfg.bg);
+    color_fg_set(g_cfg.fg, 0);
+    color_focus_set(g_cfg.focus_bg, 0);
+
+    /* no GraphicsExpose/NoExpose for back buffer copies, marquee steps included */
+    XGCValues gcv;
+    gcv.graphics_exposures = False;
+    g_gc_bg = XCreateGC(g_dpy, g_root, GCGraphicsExposures, &gcv);
+    XSetForeground(g_dpy, g_gc_bg, g_bg_pixel);
+
+    g_gc_focus = XCreateGC(g_dpy, g_root, 0, NULL);
+    XSetForeground(g_dpy, g_gc_focus, g_xc_focus.pixel);
+    startup_mark("colors, gcs");
+
+    /* map the bars now, their background is the first frame; the font follows */
+    bars_init();
+    XFlush(g_dpy);
+    startup_mark("bars mapped");
+    font_load_start();
+
+    ewmh_init();
+    startup_mark("ewmh");
+
+    /* initial spawn immediately */
+    status_apply();
+    io_add(ConnectionNumber(g_dpy), x_io, NULL);
+    startup_mark("producers");
+
+    /* main loop: sleep in epoll until a registered fd or the earliest deadline fires */
+    while (g_running) {
+        /* Xlib may already hold events it read while waiting for a reply */
+        if (XPending(g_dpy)) x_io(NULL, EPOLLIN);
+        frame_flush();
+        timers_sync();
+        io_reap();
+
+        struct epoll_event evs[16];
+        int n = epoll_wait(g_epfd, evs, 16, -1);
+        if (n < 0) {
             if (errno == EINTR) continue;
-            perror("poll");
+            perror("epoll_wait");
             break;
         }
+        for (int i = 0; i < n; ++i) {
+            IoWatch *w = evs[i].data.ptr;
+            if (w->state == 1) w->fn(w->ctx, evs[i].events);
+        }
+        /* every ready input is drained; now at most one frame with the latest state */
+        frame_flush();
     }
 
+    if (g_stats_path) dump_stats();
+
     /* cleanup */
-    if (g_draw) XftDrawDestroy(g_draw);
+    if (g_font_efd >= 0) pthread_join(g_font_thread, NULL);
+    for (int i = 0; i < g_bars_n; ++i) bar_destroy(&g_bars[i]);
+    text_cache_clear();
+    markup_fonts_close();
     if (g_font) XftFontClose(g_dpy, g_font);
     if (g_gc_bg) XFreeGC(g_dpy, g_gc_bg);
     if (g_gc_focus) XFreeGC(g_dpy, g_gc_focus);
-    if (g_win) XDestroyWindow(g_dpy, g_win);
     if (g_dpy) XCloseDisplay(g_dpy);
-    if (inofd >= 0) close(inofd);
+    wm_watch_close();
+    ipc_close();
+    shm_close();
     if (g_cmd_fd >= 0) close(g_cmd_fd);
-    if (g_cmd_pid > 0) {
-        int st = 0;
-        waitpid(g_cmd_pid, &st, WNOHANG);
+    if (g_cmd_pidfd >= 0) close(g_cmd_pidfd);
+    if (g_cmd_pid > 0) kill(-g_cmd_pid, SIGTERM);
+    for (int i = 0; i < g_right_cmds_n; ++i) {
+        RightCmd *rc = &g_right_cmds[i];
+        if (rc->fd >= 0) close(rc->fd);
+        free(rc->cmd);
     }
-    for (int i = 0; i < g_right_cmds_n; ++i) if (g_right_cmds[i]) free(g_right_cmds[i]);
-    return 0;
+    reap_children();
+    modules_close();
+    reactor_close();
+    return g_font ? 0 : 1;
 }
 
@@ -0,0 +1,214 @@
+// hsdbar_shm.h - shared-memory segment table for high-frequency status producers
+// the bar owns a memfd holding a fixed table of named segments and an eventfd doorbell;
+// producers get both over the ipc socket ("shm" request, SCM_RIGHTS) and write in place.
+// each segment is a seqlock with a single writer: no locks, and no syscalls unless the
+// bar asked for a doorbell since it last looked.
+//
+//   hsdbar_client c;
+//   if (hsdbar_shm_connect(&c) == 0) {
+//       int s = hsdbar_shm_claim(&c, "vol");
+//       hsdbar_shm_set(&c, s, "vol 40%");
+//       ...
+//       hsdbar_shm_release(&c, s);
+//       hsdbar_shm_disconnect(&c);
+//   }
+//
+// needs _GNU_SOURCE (memfd_create, F_ADD_SEALS) defined before any include
+
+#ifndef HSDBAR_SHM_H
+#define HSDBAR_SHM_H
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define HSDBAR_SHM_MAGIC 0x68736462u /* "hsdb" */
+#define HSDBAR_SHM_VERSION 1
+#define HSDBAR_SHM_SEGS 16
+#define HSDBAR_SHM_NAME 32
+#define HSDBAR_SHM_TEXT 256
+
+typedef struct {
+    _Atomic uint32_t seq;    /* odd while the writer is inside */
+    _Atomic uint32_t state;  /* 0 free, 1 claimed; name is fixed while claimed */
+    char name[HSDBAR_SHM_NAME];
+    char text[HSDBAR_SHM_TEXT];
+} hsdbar_shm_seg;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    _Atomic uint32_t armed;  /* bar wants a doorbell on the next write */
+    uint32_t pad;
+    hsdbar_shm_seg seg[HSDBAR_SHM_SEGS];
+} hsdbar_shm;
+
+typedef struct {
+    hsdbar_shm *shm;
+    int efd;                 /* doorbell eventfd, -1 = none */
+} hsdbar_client;
+
+/* ---------------- both sides ---------------- */
+
+static inline hsdbar_shm *hsdbar_shm_map(int fd) {
+    void *p = mmap(NULL, sizeof(hsdbar_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return NULL;
+    hsdbar_shm *shm = p;
+    if (shm->magic != HSDBAR_SHM_MAGIC || shm->version != HSDBAR_SHM_VERSION) {
+        munmap(p, sizeof(hsdbar_shm));
+        return NULL;
+    }
+    return shm;
+}
+
+/* new zeroed table in a memfd; returns the fd or -1 */
+static inline int hsdbar_shm_create(hsdbar_shm **out) {
+    int fd = memfd_create("hsdbar", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, sizeof(hsdbar_shm)) < 0) { close(fd); return -1; }
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+    void *p = mmap(NULL, sizeof(hsdbar_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) { close(fd); return -1; }
+    hsdbar_shm *shm = p;
+    shm->magic = HSDBAR_SHM_MAGIC;
+    shm->version = HSDBAR_SHM_VERSION;
+    *out = shm;
+    return fd;
+}
+
+/* reader: copy segment i into buf (HSDBAR_SHM_TEXT bytes) unless its sequence is
+   still *seen. returns 1 if buf was updated, 0 if unchanged or mid-write; buf is
+   only touched with a consistent copy */
+static inline int hsdbar_shm_read(hsdbar_shm *shm, int i, char *buf, uint32_t *seen) {
+    hsdbar_shm_seg *s = &shm->seg[i];
+    char tmp[HSDBAR_SHM_TEXT];
+    for (int tries = 0; tries < 4; ++tries) {
+        uint32_t s1 = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if (s1 == *seen) return 0;
+        if (s1 & 1) continue;
+        memcpy(tmp, s->text, HSDBAR_SHM_TEXT);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&s->seq, memory_order_relaxed) != s1) continue;
+        tmp[HSDBAR_SHM_TEXT - 1] = '\0';
+        memcpy(buf, tmp, strlen(tmp) + 1);
+        *seen = s1;
+        return 1;
+    }
+    return 0; /* a busy writer; the doorbell brings us back */
+}
+
+/* ---------------- producer side ---------------- */
+
+/* fetch the table and doorbell from a running bar over its ipc socket */
+static inline int hsdbar_shm_connect(hsdbar_client *c) {
+    struct sockaddr_un addr;
+    socklen_t len;
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (dir && dir[0]) {
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/hsdbar.sock", dir);
+        len = offsetof(struct sockaddr_un, sun_path) + strlen(addr.sun_path) + 1;
+    } else {
+        snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "hsdbar.%u", (unsigned)getuid());
+        len = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(addr.sun_path + 1);
+    }
+
+    c->shm = NULL;
+    c->efd = -1;
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) return -1;
+    if (connect(sock, (struct sockaddr*)&addr, len) < 0 || write(sock, "shm\n", 4) != 4) {
+        close(sock);
+        return -1;
+    }
+
+    char byte;
+    char ctrl[CMSG_SPACE(2 * sizeof(int))];
+    struct iovec iov = { &byte, 1 };
+    struct msghdr msg = { 0 };
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    ssize_t r = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    close(sock);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    if (r != 1 || !cm || cm->cmsg_type != SCM_RIGHTS || cm->cmsg_len != CMSG_LEN(2 * sizeof(int)))
+        return -1;
+    int fds[2];
+    memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+    c->shm = hsdbar_shm_map(fds[0]);
+    close(fds[0]);
+    if (!c->shm) { close(fds[1]); return -1; }
+    c->efd = fds[1];
+    return 0;
+}
+
+static inline void hsdbar_shm_disconnect(hsdbar_client *c) {
+    if (c->shm) munmap(c->shm, sizeof(hsdbar_shm));
+    if (c->efd >= 0) close(c->efd);
+    c->shm = NULL;
+    c->efd = -1;
+}
+
+/* claim a segment for name (the same name again gets its old slot back,
+   e.g. after a producer restart); returns the index or -1 if the table is full */
+static inline int hsdbar_shm_claim(hsdbar_client *c, const char *name) {
+    if (!name || !name[0] || strlen(name) >= HSDBAR_SHM_NAME) return -1;
+    for (int i = 0; i < HSDBAR_SHM_SEGS; ++i) {
+        hsdbar_shm_seg *s = &c->shm->seg[i];
+        if (atomic_load_explicit(&s->state, memory_order_acquire) == 1 &&
+            strncmp(s->name, name, HSDBAR_SHM_NAME) == 0)
+            return i;
+    }
+    for (int i = 0; i < HSDBAR_SHM_SEGS; ++i) {
+        hsdbar_shm_seg *s = &c->shm->seg[i];
+        uint32_t expect = 0;
+        /* 2 = being set up, so the bar never sees a half written name */
+        if (!atomic_compare_exchange_strong(&s->state, &expect, 2)) continue;
+        strcpy(s->name, name);
+        atomic_store_explicit(&s->state, 1, memory_order_release);
+        return i;
+    }
+    return -1;
+}
+
+/* ring the bar if it asked for it; one eventfd write per bar wakeup at most */
+static inline void hsdbar_shm_doorbell(hsdbar_client *c) {
+    if (c->efd >= 0 && atomic_exchange(&c->shm->armed, 0)) {
+        uint64_t one = 1;
+        if (write(c->efd, &one, sizeof(one)) < 0) { /* bar is gone */ }
+    }
+}
+
+/* writer side of the seqlock; only the claiming producer may write slot i */
+static inline void hsdbar_shm_set(hsdbar_client *c, int i, const char *text) {
+    if (i < 0 || i >= HSDBAR_SHM_SEGS) return;
+    hsdbar_shm_seg *s = &c->shm->seg[i];
+    uint32_t seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    size_t n = strlen(text);
+    if (n > HSDBAR_SHM_TEXT - 1) n = HSDBAR_SHM_TEXT - 1;
+    memcpy(s->text, text, n);
+    s->text[n] = '\0';
+    atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+    hsdbar_shm_doorbell(c);
+}
+
+static inline void hsdbar_shm_release(hsdbar_client *c, int i) {
+    if (i < 0 || i >= HSDBAR_SHM_SEGS) return;
+    hsdbar_shm_set(c, i, "");
+    atomic_store_explicit(&c->shm->seg[i].state, 0, memory_order_release);
+}
+
+#endif
@@ -0,0 +1,172 @@
+// bench - synthetic load for x11_status_bar, driven by tools/bench.sh
+//
+//   bench produce RATE                  status producer: RATE lines per second on stdout
+//   bench drive SECONDS WM_RATE CLICKS [EWMH_RATE]
+//                                       rewrite ~/.wm/{focused,occupied}.workspace WM_RATE
+//                                       times/s, send CLICKS synthetic ButtonPress/s to
+//                                       every dock window on $DISPLAY and churn EWMH_RATE
+//                                       fake client lists/s; prints a JSON summary
+
+#define _GNU_SOURCE
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t) {
+    struct timespec ts = { (time_t)(t / 1000000000ull), (long)(t % 1000000000ull) };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static int produce(int rate) {
+    uint64_t step = 1000000000ull / (uint64_t)rate, next = now_ns();
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    for (unsigned long n = 0;; ++n) {
+        if (printf("bench line %lu %s\n", n, (n & 1) ? "odd" : "even") < 0) return 0;
+        next += step;
+        sleep_until(next);
+    }
+}
+
+/* atomic rename-over, like the wm does */
+static void write_state(const char *dir, const char *name, const char *text) {
+    char tmp[4096], path[4096];
+    snprintf(tmp, sizeof(tmp), "%s/.%s.tmp", dir, name);
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(tmp, "w");
+    if (!f) return;
+    fputs(text, f);
+    fclose(f);
+    rename(tmp, path);
+}
+
+/* fake EWMH clients: windows with _NET_WM_DESKTOP, listed in the root's
+   _NET_CLIENT_LIST. each tick swaps half of them for new windows, so the bar
+   has to read the desktop of every newcomer */
+#define FAKE_CLIENTS 32
+static void ewmh_churn(Display *dpy, Window *wins, unsigned long tick) {
+    static Atom list, desk;
+    if (!list) {
+        list = XInternAtom(dpy, "_NET_CLIENT_LIST", False);
+        desk = XInternAtom(dpy, "_NET_WM_DESKTOP", False);
+    }
+    for (int i = (int)(tick & 1); i < FAKE_CLIENTS; i += 2) {
+        if (wins[i]) XDestroyWindow(dpy, wins[i]);
+        wins[i] = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy), 0, 0, 1, 1, 0, 0, 0);
+        long d = (long)((tick + (unsigned long)i) % 9);
+        XChangeProperty(dpy, wins[i], desk, XA_CARDINAL, 32, PropModeReplace, (unsigned char *)&d, 1);
+    }
+    XChangeProperty(dpy, DefaultRootWindow(dpy), list, XA_WINDOW, 32, PropModeReplace,
+                    (unsigned char *)wins, FAKE_CLIENTS);
+    XFlush(dpy);
+}
+
+static int find_docks(Display *dpy, Window *out, int max) {
+    Atom type = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE", False);
+    Atom dock = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DOCK", False);
+    Window root_ret, parent, *kids = NULL;
+    unsigned int nkids = 0;
+    int n = 0;
+    if (!XQueryTree(dpy, DefaultRootWindow(dpy), &root_ret, &parent, &kids, &nkids)) return 0;
+    for (unsigned int i = 0; i < nkids && n < max; ++i) {
+        Atom real;
+        int fmt;
+        unsigned long items, after;
+        unsigned char *data = NULL;
+        if (XGetWindowProperty(dpy, kids[i], type, 0, 1, False, XA_ATOM, &real, &fmt,
+                               &items, &after, &data) == Success && data) {
+            if (items && *(Atom*)data == dock) out[n++] = kids[i];
+            XFree(data);
+        }
+    }
+    if (kids) XFree(kids);
+    return n;
+}
+
+static int drive(int seconds, int wm_rate, int click_rate, int ewmh_rate) {
+    const char *home = getenv("HOME");
+    char dir[4096];
+    snprintf(dir, sizeof(dir), "%s/.wm", home ? home : ".");
+
+    Display *dpy = XOpenDisplay(NULL);
+    if (!dpy) { fprintf(stderr, "bench: cannot open display\n"); return 1; }
+    Window docks[8];
+    int ndocks = 0;
+    for (int tries = 0; tries < 50 && !ndocks; ++tries) {
+        ndocks = find_docks(dpy, docks, 8);
+        if (!ndocks) usleep(100000);
+    }
+    if (!ndocks) { fprintf(stderr, "bench: no bar window\n"); return 1; }
+
+    uint64_t start = now_ns(), end = start + (uint64_t)seconds * 1000000000ull;
+    uint64_t wm_step = wm_rate > 0 ? 1000000000ull / (uint64_t)wm_rate : 0;
+    uint64_t click_step = click_rate > 0 ? 1000000000ull / (uint64_t)click_rate : 0;
+    uint64_t ewmh_step = ewmh_rate > 0 ? 1000000000ull / (uint64_t)ewmh_rate : 0;
+    uint64_t wm_next = start, click_next = start, ewmh_next = start;
+    unsigned long wm_writes = 0, clicks = 0, ewmh_updates = 0;
+    Window fake[FAKE_CLIENTS] = { 0 };
+    while (now_ns() < end) {
+        uint64_t t = now_ns();
+        if (wm_step && t >= wm_next) {
+            char buf[64];
+            int ws = (int)(wm_writes % 9) + 1;
+            snprintf(buf, sizeof(buf), "%d\n", ws);
+            write_state(dir, "focused.workspace", buf);
+            snprintf(buf, sizeof(buf), "1 %d %d\n", ws, (ws % 9) + 1);
+            write_state(dir, "occupied.workspace", buf);
+            wm_writes++;
+            wm_next += wm_step;
+        }
+        if (click_step && t >= click_next) {
+            /* first tag with button 1, then wheel down / up */
+            static const unsigned int buttons[] = { Button1, Button5, Button4 };
+            for (int i = 0; i < ndocks; ++i) {
+                XEvent ev;
+                memset(&ev, 0, sizeof(ev));
+                ev.xbutton.type = ButtonPress;
+                ev.xbutton.window = docks[i];
+                ev.xbutton.x = 12;
+                ev.xbutton.y = 8;
+                ev.xbutton.button = buttons[clicks % 3];
+                ev.xbutton.same_screen = True;
+                XSendEvent(dpy, docks[i], False, ButtonPressMask, &ev);
+            }
+            XFlush(dpy);
+            clicks++;
+            click_next += click_step;
+        }
+        if (ewmh_step && t >= ewmh_next) {
+            ewmh_churn(dpy, fake, ewmh_updates++);
+            ewmh_next += ewmh_step;
+        }
+        uint64_t next = end;
+        if (wm_step && wm_next < next) next = wm_next;
+        if (click_step && click_next < next) next = click_next;
+        if (ewmh_step && ewmh_next < next) next = ewmh_next;
+        sleep_until(next);
+    }
+    XCloseDisplay(dpy);
+    printf("{\"seconds\":%d,\"bars\":%d,\"wm_writes\":%lu,\"clicks\":%lu,\"ewmh_updates\":%lu}\n",
+           seconds, ndocks, wm_writes, clicks, ewmh_updates);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 3 && strcmp(argv[1], "produce") == 0)
+        return produce(atoi(argv[2]) > 0 ? atoi(argv[2]) : 1);
+    if ((argc == 5 || argc == 6) && strcmp(argv[1], "drive") == 0)
+        return drive(atoi(argv[2]) > 0 ? atoi(argv[2]) : 1, atoi(argv[3]), atoi(argv[4]),
+                     argc == 6 ? atoi(argv[5]) : 0);
+    fprintf(stderr, "usage: bench produce RATE | bench drive SECONDS WM_RATE CLICK_RATE [EWMH_RATE]\n");
+    return 1;
+}
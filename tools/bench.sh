@@ -0,0 +1,54 @@
+#!/bin/sh
+# headless benchmark: Xvfb + x11_status_bar + synthetic producers, one JSON object on stdout.
+# knobs (environment): SECONDS_RUN, STATUS_RATE (lines/s), WM_RATE (rewrites/s),
+# CLICK_RATE (ButtonPress/s), EWMH_RATE (fake client list changes/s), XVFB_DISPLAY, XVFB_SCREEN
+set -eu
+
+SECONDS_RUN=${SECONDS_RUN:-10}
+STATUS_RATE=${STATUS_RATE:-50}
+WM_RATE=${WM_RATE:-20}
+CLICK_RATE=${CLICK_RATE:-5}
+EWMH_RATE=${EWMH_RATE:-5}
+XVFB_DISPLAY=${XVFB_DISPLAY:-:97}
+XVFB_SCREEN=${XVFB_SCREEN:-1920x1080x24}
+
+top=$(cd "$(dirname "$0")/.." && pwd)
+bar="$top/x11_status_bar"
+bench="$top/tools/bench"
+tmp=$(mktemp -d)
+xvfb=
+barpid=
+cleanup() {
+    [ -n "$barpid" ] && kill "$barpid" 2>/dev/null || true
+    [ -n "$xvfb" ] && kill "$xvfb" 2>/dev/null || true
+    rm -rf "$tmp"
+}
+trap cleanup EXIT INT TERM
+
+command -v Xvfb >/dev/null || { echo "bench: Xvfb not found" >&2; exit 1; }
+Xvfb "$XVFB_DISPLAY" -screen 0 "$XVFB_SCREEN" -nolisten tcp >/dev/null 2>&1 &
+xvfb=$!
+export DISPLAY="$XVFB_DISPLAY"
+for _ in 1 2 3 4 5 6 7 8 9 10; do
+    [ -e "/tmp/.X11-unix/X${XVFB_DISPLAY#:}" ] && break
+    sleep 0.2
+done
+
+# private $HOME, runtime and config dirs, so the bar's ~/.wm and ipc socket are
+# ours and the user's hsdbar config (status and right commands) stays out
+mkdir -p "$tmp/home/.wm" "$tmp/run" "$tmp/config"
+chmod 700 "$tmp/run"
+export HOME="$tmp/home" XDG_RUNTIME_DIR="$tmp/run" XDG_CONFIG_HOME="$tmp/config"
+printf '1\n' > "$HOME/.wm/focused.workspace"
+printf '1 2\n' > "$HOME/.wm/occupied.workspace"
+
+"$bar" --status-cmd "$bench produce $STATUS_RATE" --stats "$tmp/stats.json" &
+barpid=$!
+drive=$("$bench" drive "$SECONDS_RUN" "$WM_RATE" "$CLICK_RATE" "$EWMH_RATE")
+kill -TERM "$barpid"
+wait "$barpid" || true
+barpid=
+
+printf '{"config":{"seconds":%s,"status_rate":%s,"wm_rate":%s,"click_rate":%s,"ewmh_rate":%s,"screen":"%s"},' \
+    "$SECONDS_RUN" "$STATUS_RATE" "$WM_RATE" "$CLICK_RATE" "$EWMH_RATE" "$XVFB_SCREEN"
+printf '"driver":%s,"bar":%s}\n' "$drive" "$(cat "$tmp/stats.json")"
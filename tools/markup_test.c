@@ -0,0 +1,62 @@
+// markup_test - right_append and markup_parse against each other, no display needed
+// built from the bar's own source; exits non-zero on the first failure
+
+#define main bar_main
+#include "../a.c"
+#undef main
+
+static int g_fail = 0;
+
+static void expect_str(const char *what, const char *got, const char *want) {
+    if (strcmp(got, want) == 0) return;
+    printf("FAIL %s: got \"%s\", want \"%s\"\n", what, got, want);
+    g_fail = 1;
+}
+
+/* the run holding the last byte of text must carry no ^ca() action */
+static void expect_reset(const char *what, const char *text) {
+    TextRuns r;
+    memset(&r, 0, sizeof(r));
+    markup_parse(&r, text);
+    const TextRun *last = r.n ? &r.run[r.n - 1] : NULL;
+    if (last && !last->act[0]) return;
+    printf("FAIL %s: style leaks past ^r() in \"%s\"\n", what, text);
+    g_fail = 1;
+}
+
+int main(void) {
+    char buf[MAX_TEXT];
+
+    /* a trailing caret is escaped, not paired with the reset */
+    buf[0] = '\0';
+    right_append(buf, sizeof(buf), "^ca(1,x)hi^", 1);
+    right_append(buf, sizeof(buf), "next", 1);
+    expect_str("trailing caret", buf, "^ca(1,x)hi^^^r()  next");
+    expect_reset("trailing caret", buf);
+
+    /* an unterminated tag at the end is text, and stays text */
+    buf[0] = '\0';
+    right_append(buf, sizeof(buf), "^ca(1,x)a^ca(", 1);
+    right_append(buf, sizeof(buf), "b", 1);
+    expect_str("open tag", buf, "^ca(1,x)a^^ca(^r()  b");
+    expect_reset("open tag", buf);
+
+    /* a piece cut by the end of buf still gets its reset */
+    char small[24] = "";
+    right_append(small, sizeof(small), "^ca(1,cmd)a rather long piece", 1);
+    expect_str("cut piece", small, "^ca(1,cmd)a rather ^r()");
+
+    /* ... and a cut inside a tag drops the half tag */
+    char tiny[16] = "";
+    right_append(tiny, sizeof(tiny), "ab^ca(1,cmd)x", 1);
+    expect_str("cut tag", tiny, "ab^r()");
+
+    /* untrusted pieces cannot open click actions */
+    buf[0] = '\0';
+    right_append(buf, sizeof(buf), "a^ca(1,rm x)b^ca()", 0);
+    expect_str("untrusted", buf, "a^^ca(1,rm x)b^^ca()^r()");
+    expect_reset("untrusted", buf);
+
+    if (!g_fail) printf("markup_test: ok\n");
+    return g_fail;
+}
@@ -0,0 +1,100 @@
+// shm_stress - hammer the shared-memory segment table with several producers
+// every producer writes "pN <n> <n>" into its own segment as fast as it can; a reader
+// does what the bar does (seqlock reads, doorbell wakeups) and counts torn copies.
+//
+//   shm_stress [producers] [seconds]      table of its own, in-process reader
+//   shm_stress -b [producers] [seconds]   producers only, into the running bar
+
+#define _GNU_SOURCE
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "../hsdbar_shm.h"
+
+static hsdbar_shm *g_table;
+static int g_efd = -1;
+static atomic_int g_stop;
+static unsigned long g_writes[HSDBAR_SHM_SEGS];
+
+static void *producer(void *arg) {
+    int id = (int)(intptr_t)arg;
+    hsdbar_client c = { g_table, g_efd };
+    char name[16], text[64];
+    snprintf(name, sizeof(name), "p%d", id);
+    int slot = hsdbar_shm_claim(&c, name);
+    if (slot < 0) return NULL;
+    unsigned long n = 0;
+    while (!atomic_load_explicit(&g_stop, memory_order_relaxed)) {
+        ++n;
+        snprintf(text, sizeof(text), "p%d %lu %lu", id, n, n);
+        hsdbar_shm_set(&c, slot, text);
+    }
+    hsdbar_shm_release(&c, slot);
+    g_writes[id] = n;
+    return NULL;
+}
+
+/* the bar's side: wait for the doorbell, re-arm, copy what moved */
+static void read_loop(int seconds, unsigned long *wakeups, unsigned long *copies, unsigned long *torn) {
+    char text[HSDBAR_SHM_SEGS][HSDBAR_SHM_TEXT] = { { 0 } };
+    uint32_t seen[HSDBAR_SHM_SEGS] = { 0 };
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN };
+    epoll_ctl(ep, EPOLL_CTL_ADD, g_efd, &ev);
+    atomic_store(&g_table->armed, 1);
+    time_t end = time(NULL) + seconds;
+    while (time(NULL) < end) {
+        if (epoll_wait(ep, &ev, 1, 100) <= 0) continue;
+        uint64_t n;
+        if (read(g_efd, &n, sizeof(n)) < 0) continue;
+        ++*wakeups;
+        atomic_store(&g_table->armed, 1);
+        for (int i = 0; i < HSDBAR_SHM_SEGS; ++i) {
+            if (!hsdbar_shm_read(g_table, i, text[i], &seen[i])) continue;
+            ++*copies;
+            unsigned long a, b;
+            int id;
+            if (text[i][0] && (sscanf(text[i], "p%d %lu %lu", &id, &a, &b) != 3 || a != b)) ++*torn;
+        }
+    }
+    close(ep);
+}
+
+int main(int argc, char **argv) {
+    int to_bar = argc > 1 && strcmp(argv[1], "-b") == 0;
+    int producers = argc > 1 + to_bar ? atoi(argv[1 + to_bar]) : 4;
+    int seconds = argc > 2 + to_bar ? atoi(argv[2 + to_bar]) : 3;
+    if (producers < 1 || producers > HSDBAR_SHM_SEGS) producers = 4;
+    if (seconds < 1) seconds = 3;
+
+    if (to_bar) {
+        hsdbar_client c;
+        if (hsdbar_shm_connect(&c) < 0) { fprintf(stderr, "shm_stress: no bar\n"); return 1; }
+        g_table = c.shm;
+        g_efd = c.efd;
+    } else {
+        if (hsdbar_shm_create(&g_table) < 0) { perror("memfd"); return 1; }
+        g_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+
+    pthread_t th[HSDBAR_SHM_SEGS];
+    for (int i = 0; i < producers; ++i)
+        pthread_create(&th[i], NULL, producer, (void*)(intptr_t)i);
+
+    unsigned long wakeups = 0, copies = 0, torn = 0;
+    if (to_bar) sleep(seconds);
+    else read_loop(seconds, &wakeups, &copies, &torn);
+    atomic_store(&g_stop, 1);
+
+    unsigned long writes = 0;
+    for (int i = 0; i < producers; ++i) {
+        pthread_join(th[i], NULL);
+        writes += g_writes[i];
+    }
+    printf("producers %d  writes %lu (%.0f/s)\n", producers, writes, (double)writes / seconds);
+    if (!to_bar)
+        printf("reader: wakeups %lu  copies %lu  torn %lu\n", wakeups, copies, torn);
+    return torn ? 1 : 0;
+}